@@ -0,0 +1,24 @@
+#include "config-cache.h"
+
+#include <EEPROM.h>
+
+uint32_t config_fingerprint(const uint8_t *data, size_t size, uint32_t hash) {
+	for(size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 16777619UL;
+	}
+
+	return hash;
+}
+
+bool is_config_cached(ConfigSlot slot, uint32_t fingerprint) {
+	uint32_t stored;
+	EEPROM.get(CONFIG_CACHE_ADDRESS + slot * sizeof(stored), stored);
+
+	return stored == fingerprint;
+}
+
+void cache_config(ConfigSlot slot, uint32_t fingerprint) {
+	// put() only writes the bytes that differ
+	EEPROM.put(CONFIG_CACHE_ADDRESS + slot * sizeof(fingerprint), fingerprint);
+}
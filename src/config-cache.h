@@ -0,0 +1,46 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/*
+The sensors keep their configuration in flash, so it only has to be written when it changed. Each driver reads back
+what it can of the current configuration, hashes it into a fingerprint and compares it to the fingerprint stored in the
+EEPROM the last time it configured the sensor. A sensor is only reconfigured, and its configuration saved, on mismatch.
+*/
+
+// Where the fingerprints are stored in the EEPROM
+#define CONFIG_CACHE_ADDRESS 0
+
+enum ConfigSlot {
+	CONFIG_SLOT_LIDAR = 0,
+	CONFIG_SLOT_GPS,
+	CONFIG_SLOT_COUNT
+};
+
+#define CONFIG_FINGERPRINT_SEED 0x811C9DC5UL
+
+/**
+ * Computes the 32-bit FNV-1a hash of a buffer.
+ *
+ * \param data The buffer.
+ * \param size The size of the buffer.
+ * \param hash The fingerprint of the previous chunk, to hash several buffers together.
+ * \return the fingerprint
+ */
+uint32_t config_fingerprint(const uint8_t *data, size_t size, uint32_t hash = CONFIG_FINGERPRINT_SEED);
+
+/**
+ * \param slot        The sensor.
+ * \param fingerprint The fingerprint of its current configuration.
+ * \return whether the fingerprint is the one stored for the sensor
+ */
+bool is_config_cached(ConfigSlot slot, uint32_t fingerprint);
+
+/**
+ * Stores the fingerprint of a sensor's configuration. The EEPROM is only written if it changed.
+ *
+ * \param slot        The sensor.
+ * \param fingerprint The fingerprint of its new configuration.
+ */
+void cache_config(ConfigSlot slot, uint32_t fingerprint);
@@ -12,6 +12,10 @@
 #define DEBUG_TO_SERIAL
 #endif
 
+#if defined(DEBUG_TO_SERIAL) && defined(TELEMETRY_USB)
+#error TELEMETRY_USB uses the USB port, it cannot be combined with DEBUG_DATA or DEBUG_NMEA
+#endif
+
 #ifdef DEBUG_TO_SERIAL
 
 #define DEBUG_STREAM Serial
@@ -0,0 +1,67 @@
+#include "frame.h"
+
+uint16_t crc16(const uint8_t *data, size_t size, uint16_t crc) {
+	for(size_t i = 0; i < size; i++) {
+		crc ^= (uint16_t) data[i] << 8;
+		for(uint8_t bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+
+	return crc;
+}
+
+size_t encode_frame(const uint8_t *payload, size_t size, uint8_t *frame) {
+	uint16_t crc = crc16(payload, size);
+	const uint8_t trailer[2] = { (uint8_t) (crc & 0xFF), (uint8_t) (crc >> 8) };
+
+	// COBS: every run of up to 254 non-zero bytes is prefixed by its length plus one, and the zero that ends it is
+	// dropped
+	size_t code_index = 0;
+	size_t out = 1;
+	uint8_t code = 1;
+
+	for(size_t i = 0; i < size + 2; i++) {
+		uint8_t byte = i < size ? payload[i] : trailer[i - size];
+
+		if(byte != 0) {
+			frame[out++] = byte;
+			code++;
+		}
+
+		if(byte == 0 || code == 0xFF) {
+			frame[code_index] = code;
+			code_index = out++;
+			code = 1;
+		}
+	}
+
+	frame[code_index] = code;
+	frame[out++] = 0;
+
+	return out;
+}
+
+int decode_frame(const uint8_t *frame, size_t size, uint8_t *payload) {
+	size_t in = 0;
+	size_t out = 0;
+
+	while(in < size) {
+		uint8_t code = frame[in++];
+		if(code == 0 || in + code - 1 > size) return -1;
+
+		for(uint8_t i = 1; i < code; i++) {
+			if(frame[in] == 0) return -1;
+			payload[out++] = frame[in++];
+		}
+
+		if(code < 0xFF && in < size) payload[out++] = 0;
+	}
+
+	if(out < 2) return -1;
+	out -= 2;
+
+	uint16_t crc = payload[out] | (payload[out + 1] << 8);
+	if(crc16(payload, out) != crc) return -1;
+
+	return out;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/*
+Framing used by the binary telemetry. A frame is a payload followed by its CRC-16 (little endian), COBS-encoded so it
+contains no zero byte, and terminated by a zero byte. A receiver that loses sync only has to wait for the next zero.
+
+Like sample.h, this is shared with the host-side tools; do not include any Arduino header here.
+*/
+
+// The largest encoded size of a frame with a payload of `size` bytes, including the terminating zero
+#define FRAME_ENCODED_SIZE(size) ((size) + 2 + ((size) + 2) / 254 + 2)
+
+/**
+ * Computes the CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF) of a buffer.
+ *
+ * \param data The buffer.
+ * \param size The size of the buffer.
+ * \param crc  The CRC of the previous chunk, to compute it in several steps.
+ * \return the CRC
+ */
+uint16_t crc16(const uint8_t *data, size_t size, uint16_t crc = 0xFFFF);
+
+/**
+ * Builds a frame out of a payload.
+ *
+ * \param[in]  payload The payload.
+ * \param      size    The size of the payload.
+ * \param[out] frame   The frame, at least `FRAME_ENCODED_SIZE(size)` bytes long.
+ * \return the size of the frame, including the terminating zero
+ */
+size_t encode_frame(const uint8_t *payload, size_t size, uint8_t *frame);
+
+/**
+ * Decodes a frame and checks its CRC. The decoding can be done in place.
+ *
+ * \param[in]  frame   The frame, without the terminating zero.
+ * \param      size    The size of the frame.
+ * \param[out] payload The payload, at least `size` bytes long.
+ * \return the size of the payload
+ * \retval -1 if the frame is malformed or its CRC does not match
+ */
+int decode_frame(const uint8_t *frame, size_t size, uint8_t *payload);
@@ -2,10 +2,167 @@
 
 #include "./common.h"
 
+#include "../config-cache.h"
 #include "../debug.h"
 
 TinyGPSPlus gps;
 
+// UBX messages of the CFG class, and the acknowledgement
+#define UBX_SYNC_1 0xB5
+#define UBX_SYNC_2 0x62
+#define UBX_CFG 0x06
+#define UBX_CFG_MSG 0x01
+#define UBX_CFG_RATE 0x08
+#define UBX_CFG_CFG 0x09
+#define UBX_ACK 0x05
+#define UBX_ACK_ACK 0x01
+
+// How long the receiver has to answer, in milliseconds
+#define UBX_TIMEOUT 250
+
+#define NMEA_CLASS 0xF0
+
+/**
+ * The output rate of an NMEA message on each port: I2C, UART1, UART2, USB, SPI and a reserved one.
+ */
+struct MessageRate {
+	uint8_t id;
+	uint8_t rates[6];
+};
+
+static const MessageRate message_rates[] PROGMEM = {
+	// Deactivate the messages we do not want
+	{ 0x01, { 0x01, 0x00, 0x01, 0x01, 0x01, 0x01 } },  // GLL
+	{ 0x02, { 0x01, 0x00, 0x01, 0x01, 0x01, 0x01 } },  // GSA
+	{ 0x03, { 0x01, 0x00, 0x01, 0x01, 0x01, 0x01 } },  // GSV
+	{ 0x05, { 0x01, 0x00, 0x01, 0x01, 0x01, 0x01 } },  // VTG
+	{ 0x08, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },  // ZDA
+	// Keep the messages we want
+	{ 0x00, { 0x01, 0x01, 0x01, 0x01, 0x01, 0x01 } },  // GGA
+	{ 0x04, { 0x01, 0x01, 0x01, 0x01, 0x01, 0x01 } }   // RMC
+};
+
+/**
+ * Sends a UBX message of the CFG class.
+ */
+static void ubx_send(uint8_t id, const uint8_t *payload, uint16_t size) {
+	const uint8_t header[4] = { UBX_CFG, id, (uint8_t) (size & 0xFF), (uint8_t) (size >> 8) };
+	uint8_t ck_a = 0, ck_b = 0;
+
+	for(size_t i = 0; i < sizeof(header); i++) {
+		ck_a += header[i];
+		ck_b += ck_a;
+	}
+	for(size_t i = 0; i < size; i++) {
+		ck_a += payload[i];
+		ck_b += ck_a;
+	}
+
+	Serial1.write(UBX_SYNC_1);
+	Serial1.write(UBX_SYNC_2);
+	Serial1.write(header, sizeof(header));
+	Serial1.write(payload, size);
+	Serial1.write(ck_a);
+	Serial1.write(ck_b);
+}
+
+/**
+ * Waits for a UBX message. The NMEA sentences received in the meantime are handed to TinyGPS++.
+ *
+ * \param      message_class The class of the message.
+ * \param      id            The id of the message.
+ * \param[out] payload       The payload of the message.
+ * \param      capacity      The size of `payload`; larger messages are ignored.
+ * \return the size of the payload
+ * \retval -1 if the message was not received in time
+ */
+static int ubx_receive(uint8_t message_class, uint8_t id, uint8_t *payload, size_t capacity) {
+	unsigned long start = millis();
+	auto read_byte = [start]() -> int {
+		while(!Serial1.available())
+			if(millis() - start >= UBX_TIMEOUT) return -1;
+		return Serial1.read();
+	};
+
+	while(true) {
+		int c = read_byte();
+		if(c < 0) return -1;
+		if(c != UBX_SYNC_1) {
+			gps.encode(c);
+			continue;
+		}
+		if(read_byte() != UBX_SYNC_2) continue;
+
+		uint8_t header[4];
+		uint8_t ck_a = 0, ck_b = 0;
+		for(size_t i = 0; i < sizeof(header); i++) {
+			c = read_byte();
+			if(c < 0) return -1;
+			header[i] = c;
+			ck_a += c;
+			ck_b += ck_a;
+		}
+
+		uint16_t size = header[2] | (header[3] << 8);
+		bool wanted = header[0] == message_class && header[1] == id && size <= capacity;
+
+		for(uint16_t i = 0; i < size; i++) {
+			c = read_byte();
+			if(c < 0) return -1;
+			if(wanted) payload[i] = c;
+			ck_a += c;
+			ck_b += ck_a;
+		}
+
+		if(read_byte() == ck_a && read_byte() == ck_b && wanted) return size;
+	}
+}
+
+/**
+ * Sends a UBX message of the CFG class and waits for it to be acknowledged.
+ *
+ * \return whether the receiver acknowledged the message
+ */
+static bool ubx_command(uint8_t id, const uint8_t *payload, uint16_t size) {
+	ubx_send(id, payload, size);
+
+	uint8_t ack[2];
+	return ubx_receive(UBX_ACK, UBX_ACK_ACK, ack, sizeof(ack)) == 2 && ack[0] == UBX_CFG && ack[1] == id;
+}
+
+/**
+ * Reads back the configuration of the receiver: the output rate of each NMEA message and the navigation rate.
+ *
+ * \param[out] fingerprint The fingerprint of the configuration.
+ * \return whether the configuration could be read and the message rates are the ones we want
+ */
+static bool read_config(uint32_t &fingerprint) {
+	bool matches = true;
+	fingerprint = CONFIG_FINGERPRINT_SEED;
+
+	for(size_t i = 0; i < sizeof(message_rates) / sizeof(message_rates[0]); i++) {
+		MessageRate message;
+		memcpy_P(&message, &message_rates[i], sizeof(message));
+
+		// Polling CFG-MSG with only the class and id returns the rates on every port
+		uint8_t payload[8] = { NMEA_CLASS, message.id };
+		ubx_send(UBX_CFG_MSG, payload, 2);
+		int size = ubx_receive(UBX_CFG, UBX_CFG_MSG, payload, sizeof(payload));
+		if(size != sizeof(payload) || payload[1] != message.id) return false;
+
+		matches = matches && memcmp(payload + 2, message.rates, sizeof(message.rates)) == 0;
+		fingerprint = config_fingerprint(payload, size, fingerprint);
+	}
+
+	uint8_t rate[6];
+	ubx_send(UBX_CFG_RATE, rate, 0);
+	int size = ubx_receive(UBX_CFG, UBX_CFG_RATE, rate, sizeof(rate));
+	if(size != sizeof(rate)) return false;
+	fingerprint = config_fingerprint(rate, size, fingerprint);
+
+	return matches;
+}
+
 bool setup_gps() {
 	// GPS is on the ProMicro's UART (Serial1)
 	// RX: pin 0; TX: pin 1
@@ -34,55 +191,28 @@ bool setup_gps() {
 		}
 	}
 
-	// TinyGPS++ mainly works on GGA and RMC, so we turn off the other NMEA sentences
-
-	// Deactivate the messages we do not want
-
-	// "\xB5\x62\x06\x01\x08\x00\xF0\x01\x01\x00\x01\x01\x01\x01\x05\x3A"
-	Serial1.write("\xB5\x62\x06\x01\x08\x00\xF0\x01\x01\x00\x01\x01\x01\x01\x05\x3A", 16);  // GLL
-
-	delay(250);
-	while(Serial1.available()) Serial1.read();
-
-	Serial1.write("\xB5\x62\x06\x01\x08\x00\xF0\x02\x01\x00\x01\x01\x01\x01\x06\x41", 16);  // GSA
-
-	delay(250);
-	while(Serial1.available()) Serial1.read();
-
-	Serial1.write("\xB5\x62\x06\x01\x08\x00\xF0\x03\x01\x00\x01\x01\x01\x01\x07\x48", 16);  // GSV
-
-	delay(250);
-	while(Serial1.available()) Serial1.read();
-
-	Serial1.write("\xB5\x62\x06\x01\x08\x00\xF0\x05\x01\x00\x01\x01\x01\x01\x09\x56", 16);  // VTG
-
-	delay(250);
-	while(Serial1.available()) Serial1.read();
-
-	Serial1.write("\xB5\x62\x06\x01\x08\x00\xF0\x08\x00\x00\x00\x00\x00\x00\x07\x5B", 16);  // ZDA
-
-	delay(250);
-	while(Serial1.available()) Serial1.read();
-
-	// Keep the messages we want
-	Serial1.write("\xB5\x62\x06\x01\x08\x00\xF0\x00\x01\x01\x01\x01\x01\x01\x05\x38", 16);  // GGA
-
-	delay(250);
-	while(Serial1.available()) Serial1.read();
-
-	Serial1.write("\xB5\x62\x06\x01\x08\x00\xF0\x04\x01\x01\x01\x01\x01\x01\x09\x54", 16);  // RMC
+	uint32_t fingerprint;
+	if(read_config(fingerprint) && is_config_cached(CONFIG_SLOT_GPS, fingerprint)) {
+		DEBUGLN(F("GPS already configured"));
+		return true;
+	}
 
-	delay(250);
-	while(Serial1.available()) Serial1.read();
+	// TinyGPS++ mainly works on GGA and RMC, so we turn off the other NMEA sentences
+	for(size_t i = 0; i < sizeof(message_rates) / sizeof(message_rates[0]); i++) {
+		MessageRate message;
+		memcpy_P(&message, &message_rates[i], sizeof(message));
 
-	delay(250);
+		uint8_t payload[8] = { NMEA_CLASS, message.id };
+		memcpy(payload + 2, message.rates, sizeof(message.rates));
+		if(!ubx_command(UBX_CFG_MSG, payload, sizeof(payload))) DEBUGLN(F("GPS did not acknowledge CFG-MSG"));
+	}
 
 	// Save the configuration
-	Serial1.write("\xB5\x62\x06\x09\x0C\x00\x00\x00\x00\x00\xFF\xFF\x00\x00\x00\x00\x00\x00\x19\x80", 20);
+	const uint8_t save[12] = { 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	if(!ubx_command(UBX_CFG_CFG, save, sizeof(save))) DEBUGLN(F("GPS did not acknowledge CFG-CFG"));
 
-	// FIXME wait for ACKs, do not discard
-	delay(250);
-	while(Serial1.available()) Serial1.read();
+	if(read_config(fingerprint)) cache_config(CONFIG_SLOT_GPS, fingerprint);
+	else DEBUGLN(F("GPS configuration could not be verified"));
 
     return true;
 }
@@ -10,6 +10,9 @@ digest the NMEA sentences coming in. The TinyGPS++ examples have a smartDelay()
 // The TinyGPS++ object
 extern TinyGPSPlus gps;
 
+// A date and time older than this, in milliseconds, are those of a lost fix
+#define GPS_FIX_TIMEOUT_MS 1750
+
 /**
  * Sets up the GPS module and wait for a fix.
  * 
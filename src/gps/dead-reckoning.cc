@@ -0,0 +1,85 @@
+#include "dead-reckoning.h"
+
+#include <Arduino.h>
+
+// sin(x) * 32767 for x in 0..90 degrees
+static const int16_t sine_table[91] PROGMEM = {
+	0, 572, 1144, 1715, 2286, 2856, 3425, 3993, 4560, 5126,
+	5690, 6252, 6813, 7371, 7927, 8481, 9032, 9580, 10126, 10668,
+	11207, 11743, 12275, 12803, 13328, 13848, 14364, 14876, 15383, 15886,
+	16383, 16876, 17364, 17846, 18323, 18794, 19260, 19720, 20173, 20621,
+	21062, 21497, 21925, 22347, 22762, 23170, 23571, 23964, 24351, 24730,
+	25101, 25465, 25821, 26169, 26509, 26841, 27165, 27481, 27788, 28087,
+	28377, 28659, 28932, 29196, 29451, 29697, 29934, 30162, 30381, 30591,
+	30791, 30982, 31163, 31335, 31498, 31650, 31794, 31927, 32051, 32165,
+	32269, 32364, 32448, 32523, 32587, 32642, 32687, 32722, 32747, 32762,
+	32767
+};
+
+/*
+A knot is one minute of latitude per hour. The rates are kept in 1e-7 degrees per 1024 ms, with 4 fractional bits, so
+extrapolating is a multiplication and a shift. One unit of `speed_ckn` is then 1e7 / 60 / 3600 * 1.024 * 16 / 100 =
+7.5852, which is 31069 with 12 fractional bits.
+*/
+#define CKN_TO_RATE_Q12 31069L
+#define RATE_SHIFT 14
+
+// The last fix, and the rates derived from it
+static struct {
+	int32_t latitude_e7;
+	uint16_t speed_ckn;
+	uint16_t course_cdeg;
+
+	int32_t latitude_rate;
+	int32_t longitude_rate;
+} fix;
+
+/**
+ * \param degrees The angle, in degrees, in 0..359.
+ * \return the sine of the angle * 32767
+ */
+static int16_t sine_q15(uint16_t degrees) {
+	if(degrees < 90) return pgm_read_word(&sine_table[degrees]);
+	if(degrees < 180) return pgm_read_word(&sine_table[180 - degrees]);
+	if(degrees < 270) return -pgm_read_word(&sine_table[degrees - 180]);
+	return -pgm_read_word(&sine_table[360 - degrees]);
+}
+
+/**
+ * Derives the rates of change of the latitude and longitude from a new fix. This is only done once per fix, so the
+ * 64-bit arithmetic does not weigh on the sampling.
+ */
+static void update_rates(const Sample &sample) {
+	fix.latitude_e7 = sample.latitude_e7;
+	fix.speed_ckn = sample.speed_ckn;
+	fix.course_cdeg = sample.course_cdeg;
+
+	uint16_t course = ((sample.course_cdeg + 50) / 100) % 360;
+	int64_t velocity = (int64_t) sample.speed_ckn * CKN_TO_RATE_Q12;
+
+	fix.latitude_rate = (velocity * sine_q15((course + 90) % 360)) >> 27;
+
+	// A degree of longitude shrinks with the cosine of the latitude
+	int32_t latitude = sample.latitude_e7 < 0 ? -sample.latitude_e7 : sample.latitude_e7;
+	int16_t cos_latitude = sine_q15(90 - min((latitude + 5000000L) / 10000000L, 89L));
+
+	fix.longitude_rate = ((velocity * sine_q15(course)) >> 12) / cos_latitude;
+}
+
+void dead_reckon(Sample &sample) {
+	sample.extrap_age_ms = 0;
+
+	const uint8_t required = SAMPLE_LOCATION_VALID | SAMPLE_SPEED_VALID | SAMPLE_COURSE_VALID;
+	if((sample.flags & required) != required) return;
+	if(sample.speed_ckn < DEAD_RECKONING_MIN_SPEED_CKN) return;
+
+	if(sample.latitude_e7 != fix.latitude_e7 || sample.speed_ckn != fix.speed_ckn
+			|| sample.course_cdeg != fix.course_cdeg)
+		update_rates(sample);
+
+	int32_t age = min(sample.fix_age_ms, (uint16_t) DEAD_RECKONING_MAX_AGE_MS);
+	sample.extrap_age_ms = age;
+
+	sample.latitude_e7 += (fix.latitude_rate * age) >> RATE_SHIFT;
+	sample.longitude_e7 += (fix.longitude_rate * age) >> RATE_SHIFT;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "../sample.h"
+
+/*
+The GPS only reports a position once per second, while the sensors are sampled faster. Between fixes the position is
+extrapolated from the speed and course of the last RMC sentence and the age of the fix.
+*/
+
+// Fixes older than this, in milliseconds, are not extrapolated any further
+#define DEAD_RECKONING_MAX_AGE_MS 3000
+
+// Below this speed, in knots * 100, the course is mostly noise and the position is held
+#define DEAD_RECKONING_MIN_SPEED_CKN 50
+
+/**
+ * Moves the position of a sample to where the receiver should be `sample.fix_age_ms` after the fix, up to
+ * `DEAD_RECKONING_MAX_AGE_MS`, and stores the age actually applied in `sample.extrap_age_ms`. The position is held, and
+ * 0 stored, when the location, speed or course are not valid or the speed is below `DEAD_RECKONING_MIN_SPEED_CKN`.
+ * All the arithmetic is fixed-point.
+ *
+ * \param[in,out] sample The sample, holding the last fix and its age.
+ */
+void dead_reckon(Sample &sample);
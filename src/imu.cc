@@ -11,7 +11,7 @@ bool setup_imu() {
     return true;
 }
 
-void get_imu_readings(IMUData &results) {
+void get_imu_readings(IMUData &results, uint8_t imu_samples, void (*between)()) {
 	// The Pololu MinIMU-9 v5 has a LSM6DS33 gyro and accel sensor. The values returned by the library are the raw
 	// 16-bit values the sensor outputs. They can be converted to units of g (acceleration of gravity) and °/s using
 	// the conversion factors specified in the  datasheet for your particular device and full scale setting (gain).
@@ -24,8 +24,6 @@ void get_imu_readings(IMUData &results) {
 	// TODO investigate the use of linear or polynimal regression
 
 	// for 400 samples it takes ~852ms; 100 samples take 212ms.
-	constexpr size_t imu_samples = 100;
-
 	long sum_accel_x = 0, sum_accel_y = 0, sum_accel_z = 0;
 	long sum_gyro_x = 0, sum_gyro_y = 0, sum_gyro_z = 0;
 
@@ -50,6 +48,8 @@ void get_imu_readings(IMUData &results) {
 		sum_gyro_x += imu.g.z;
 		sum_gyro_y += -imu.g.x;
 		sum_gyro_z += -imu.g.y;
+
+		if(between) between();
 		}
 	digitalWrite(LED_BUILTIN_RX, HIGH);
 
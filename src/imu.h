@@ -14,6 +14,10 @@ static LSM6 imu;
 bool setup_imu();
 
 /**
- * Reads the IMU's data. This function reads 100 samples and returns the arithmetic mean.
+ * Reads the IMU's data. This function reads a number of samples and returns the arithmetic mean.
+ *
+ * \param[out] results     The mean of the samples.
+ * \param      imu_samples The number of samples; 100 samples take ~212ms.
+ * \param      between     Called after each sample, to sample other sensors meanwhile.
  */
-void get_imu_readings(IMUData &results);
+void get_imu_readings(IMUData &results, uint8_t imu_samples = 100, void (*between)() = nullptr);
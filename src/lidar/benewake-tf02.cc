@@ -5,18 +5,22 @@ D2 and D3.
 
 #ifdef LIDAR_BENEWAKE_TF02
 
-#include "common.h"
+#include "benewake-tf02.h"
 
 #include <Arduino.h>
 #include <Wire.h>
 
+#include "../config-cache.h"
 #include "../debug.h"
 
-// The I2C address of the lidar is preset to 0x10
-#define I2C_ADDR 0x10
+// Set framerate to 1000
+#define SET_FRAME_RATE "\x5A\x06\x03\xE8\x03\x4E"
 
-void read_response(size_t size) {
-    Wire.requestFrom(I2C_ADDR, size);
+// Set output format to 9 bytes, in centimetres
+#define SET_OUTPUT_FORMAT "\x5A\x05\x05\x01\x65"
+
+void BenewakeTF02::read_response(uint8_t size) {
+    Wire.requestFrom(address, size);
 
     DEBUG(F("Response: "));
     while(Wire.available()) {
@@ -30,19 +34,21 @@ void read_response(size_t size) {
     DEBUGLN();
 }
 
-bool setup_lidar() {
+bool BenewakeTF02::setup() {
 	// startup I2C bus for the LiDAR
 	Wire.begin();
     Wire.setTimeout(250);
 
+    uint8_t version[3];
+
     // Get firmware version major:u8 minor:u8 micro:u48
-    Wire.beginTransmission(I2C_ADDR);
+    Wire.beginTransmission(address);
     Wire.write("\x5A\x04\x01\x5F");
     Wire.endTransmission();
     delay(100);
 
     {
-        size_t size = Wire.requestFrom(I2C_ADDR, 7);
+        size_t size = Wire.requestFrom(address, (uint8_t) 7);
         if(size == 0) {
             DEBUG(F("The LiDAR is probably in serial mode"));
             return false;
@@ -50,44 +56,65 @@ bool setup_lidar() {
 
         Wire.read(); Wire.read(); Wire.read();
 
-        uint8_t micro_version = Wire.read();
-        uint8_t minor_version = Wire.read();
-        uint8_t major_version = Wire.read();
-        
+        // micro, minor, major
+        for(size_t i = 0; i < 3; i++) version[i] = Wire.read();
+
         Wire.read();
 
         DEBUG("LiDAR FW: ");
-        DEBUG(major_version);
+        DEBUG(version[2]);
         DEBUG('.');
-        DEBUG(minor_version);
+        DEBUG(version[1]);
         DEBUG('.');
-        DEBUGLN(micro_version);
+        DEBUGLN(version[0]);
     }
 
-    // Set framerate to 1000
-    Wire.beginTransmission(I2C_ADDR);
-    Wire.write("\x5A\x06\x03\xE8\x03\x4E");
+    // Neither the frame rate nor the output format can be read back over I2C, so the skip rests on the fingerprint
+    // alone: the address and firmware version, which were just read, and the commands we would send. The reading
+    // triggered below does not check the format, the command names the 9 bytes, centimetres format itself; it only
+    // checks that the lidar answers measurements.
+    uint32_t fingerprint = config_fingerprint(&address, sizeof(address));
+    fingerprint = config_fingerprint(version, sizeof(version), fingerprint);
+    fingerprint = config_fingerprint((const uint8_t *) SET_FRAME_RATE, sizeof(SET_FRAME_RATE) - 1, fingerprint);
+    fingerprint = config_fingerprint((const uint8_t *) SET_OUTPUT_FORMAT, sizeof(SET_OUTPUT_FORMAT) - 1, fingerprint);
+
+    trigger();
+    if(is_config_cached(CONFIG_SLOT_LIDAR, fingerprint) && read_distance_cm() != -1) {
+        DEBUGLN(F("LiDAR already configured"));
+        return true;
+    }
+
+    Wire.beginTransmission(address);
+    Wire.write(SET_FRAME_RATE);
     Wire.endTransmission();
     delay(100);
     read_response(6);
 
-    // Set output format
-    Wire.beginTransmission(I2C_ADDR);
-    Wire.write("\x5A\x05\x05\x01\x65");
+    Wire.beginTransmission(address);
+    Wire.write(SET_OUTPUT_FORMAT);
     Wire.endTransmission();
     delay(100);
     read_response(5);
 
     // Save configuration
-    Wire.beginTransmission(I2C_ADDR);
+    Wire.beginTransmission(address);
     Wire.write("\x5A\x04\x11\x6F");
     Wire.endTransmission();
     delay(100);
     read_response(5); // MUST BE hex { 5A 05 11 01 71 }
-	
+
+    cache_config(CONFIG_SLOT_LIDAR, fingerprint);
+
 	return true;  // We assume it has successfully set communication
 }
 
+// Trigger detection, with the output in the 9 bytes, centimetres format
+void BenewakeTF02::trigger() {
+    Wire.beginTransmission(address);
+    Wire.write("\x5A\x05\x00\x01\x60", 5);
+    Wire.endTransmission();
+}
+
 /**
  * 0x5959: u16 - Start of each message
  * distance: u16 - The distance in centimetres
@@ -95,14 +122,10 @@ bool setup_lidar() {
  * temp: u16 - The temperature in °C
  * checksum: u8 - The message checksum
  */
-int16_t get_lidar_distance_cm() {
+int16_t BenewakeTF02::read_distance_cm() {
     uint8_t msg[10];
 
-    Wire.beginTransmission(I2C_ADDR);
-    Wire.write("\x5A\x05\x00\x01\x60", 5);
-    Wire.endTransmission();
-
-	Wire.requestFrom(I2C_ADDR, 9);
+	Wire.requestFrom(address, (uint8_t) 9);
 
     size_t size = Wire.available();
     size_t limit = size > 9 ? 9 : size;
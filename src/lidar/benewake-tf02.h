@@ -0,0 +1,29 @@
+#pragma once
+
+#include "common.h"
+
+// The I2C address of the lidar is preset to 0x10
+#ifndef LIDAR_TF02_I2C_ADDR
+#define LIDAR_TF02_I2C_ADDR 0x10
+#endif
+
+// The lidar measures at 1000 Hz, it is polled at 100 Hz to leave the bus to the IMU
+#ifndef LIDAR_TF02_PERIOD_MS
+#define LIDAR_TF02_PERIOD_MS 10
+#endif
+
+/**
+ * Benewake TF02-Pro, in I²C mode.
+ */
+class BenewakeTF02 : public Lidar {
+public:
+	using Lidar::Lidar;
+
+	bool setup() override;
+	void trigger() override;
+	int16_t read_distance_cm() override;
+	uint16_t period_ms() const override { return LIDAR_TF02_PERIOD_MS; }
+
+private:
+	void read_response(uint8_t size);
+};
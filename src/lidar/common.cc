@@ -0,0 +1,80 @@
+#include "common.h"
+
+#include <Arduino.h>
+
+#include "benewake-tf02.h"
+#include "lightware-sf11-c.h"
+
+#if !defined(LIDAR_BENEWAKE_TF02) && !defined(LIDAR_LIGHTWARE_SF11)
+#error Select a lidar with LIDAR_BENEWAKE_TF02 and/or LIDAR_LIGHTWARE_SF11
+#endif
+
+#ifdef LIDAR_BENEWAKE_TF02
+static BenewakeTF02 tf02(LIDAR_TF02_I2C_ADDR);
+#endif
+
+#ifdef LIDAR_LIGHTWARE_SF11
+static LightwareSF11 sf11(LIDAR_SF11_I2C_ADDR);
+#endif
+
+Lidar *const lidars[LIDAR_COUNT] = {
+#ifdef LIDAR_BENEWAKE_TF02
+	&tf02,
+#endif
+#ifdef LIDAR_LIGHTWARE_SF11
+	&sf11,
+#endif
+};
+
+// The state of each lidar between polls, and the readings accumulated for the current row
+static struct {
+	bool triggered;
+	unsigned long last_visit_ms;
+
+	uint8_t count;
+	int32_t sum_cm;
+} polls[LIDAR_COUNT];
+
+static size_t next_lidar = 0;
+
+/**
+ * Reads the pending measurement of a lidar, if any, and triggers the next one.
+ */
+static void visit(size_t i) {
+	if(polls[i].triggered) {
+		int16_t distance = lidars[i]->read_distance_cm();
+		if(distance != -1 && polls[i].count < 0xFF) {
+			polls[i].count++;
+			polls[i].sum_cm += distance;
+		}
+	}
+
+	lidars[i]->trigger();
+	polls[i].triggered = true;
+	polls[i].last_visit_ms = millis();
+}
+
+void poll_lidars() {
+	size_t i = next_lidar;
+	next_lidar = (next_lidar + 1) % LIDAR_COUNT;
+
+	if(!polls[i].triggered || millis() - polls[i].last_visit_ms >= lidars[i]->period_ms()) visit(i);
+}
+
+void read_lidars(int16_t distances_cm[LIDAR_COUNT]) {
+	for(size_t i = 0; i < LIDAR_COUNT; i++) {
+		// A lidar slower than the row, or never polled, is read once for the row
+		if(polls[i].count == 0) {
+			if(!polls[i].triggered) visit(i);
+			visit(i);
+		}
+
+		if(polls[i].count > 0)
+			distances_cm[i] = (polls[i].sum_cm + polls[i].count / 2) / polls[i].count;
+		else
+			distances_cm[i] = -1;
+
+		polls[i].count = 0;
+		polls[i].sum_cm = 0;
+	}
+}
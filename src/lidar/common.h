@@ -1,20 +1,70 @@
 #pragma once
 
 #include <inttypes.h>
+#include <stddef.h>
 
 /**
- * Starts the lidar hardware and setup communication.
- * 
- * @return wether it was started correctly
- * @retval true successfully started
- * @retval false error during lidar initialisation
+ * A lidar on the I²C bus. A measurement is split into a trigger and a read, so one lidar can be measuring while another
+ * is being read.
  */
-bool setup_lidar();
+class Lidar {
+public:
+	/**
+	 * \param address The I²C address of the lidar.
+	 */
+	explicit Lidar(uint8_t address) : address(address) {}
+
+	/**
+	 * Starts the lidar hardware and setup communication.
+	 * 
+	 * @return wether it was started correctly
+	 * @retval true successfully started
+	 * @retval false error during lidar initialisation
+	 */
+	virtual bool setup() = 0;
+
+	/**
+	 * Asks the lidar for a new measurement.
+	 */
+	virtual void trigger() = 0;
+
+	/**
+	 * Reads the distance measured since the last trigger. The reading is returned in centimetres.
+	 * 
+	 * @return the distance in cenimetres
+	 * @retval -1 if it was not able to read the distance
+	 */
+	virtual int16_t read_distance_cm() = 0;
+
+	/**
+	 * @return the interval between two new measurements, in milliseconds
+	 */
+	virtual uint16_t period_ms() const = 0;
+
+protected:
+	const uint8_t address;
+};
+
+// The lidars selected by the build flags, in the order of their columns in the log
+#if defined(LIDAR_BENEWAKE_TF02) && defined(LIDAR_LIGHTWARE_SF11)
+#define LIDAR_COUNT 2
+#else
+#define LIDAR_COUNT 1
+#endif
+
+extern Lidar *const lidars[LIDAR_COUNT];
+
+/**
+ * Samples the lidars at their own rates, to be called as often as possible while the other sensors are read. Each call
+ * visits one lidar, in turn, when its period has elapsed: its pending measurement is read and the next one triggered,
+ * so it measures while the others are visited. The readings are accumulated until `read_lidars()`.
+ */
+void poll_lidars();
 
 /**
- * Reads the distance from the lidar. The reading is returned in centimetres.
- * 
- * @return the distance in cenimetres
- * @retval -1 if it was not able to read the distance
+ * Returns the mean of the distances read by every lidar since the last call. A lidar that was not read in the meantime
+ * is read now.
+ *
+ * \param[out] distances_cm The mean distance of each lidar, or -1.
  */
-int16_t get_lidar_distance_cm();
+void read_lidars(int16_t distances_cm[LIDAR_COUNT]);
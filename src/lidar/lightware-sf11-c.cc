@@ -5,30 +5,31 @@ D2 and D3.
 
 #ifdef LIDAR_LIGHTWARE_SF11
 
-#include "common.h"
+#include "lightware-sf11-c.h"
 
 #include <Wire.h>
 
 //#define I2C_SDA 2
 //#define I2C_SCL 3
 
-// The I2C address of the lidar is preset to 0x55
-#define I2C_ADR 0x55
-
-bool setup_lidar() {
+bool LightwareSF11::setup() {
 	// startup I2C bus for the LiDAR
 	Wire.begin();
 
 	// Instruct the lidar to activate the distance location
-	Wire.beginTransmission(I2C_ADR);
+	Wire.beginTransmission(address);
 	Wire.write(0);
 	Wire.endTransmission();
 	
 	return true;  // We assume it has successfully set communication
 }
 
-int16_t get_lidar_distance_cm() {
-	Wire.requestFrom(I2C_ADR, 2);
+void LightwareSF11::trigger() {
+	// The SF11 measures on its own and is read for its last measurement, there is nothing to ask for
+}
+
+int16_t LightwareSF11::read_distance_cm() {
+	Wire.requestFrom(address, (uint8_t) 2);
 
 	if(Wire.available() < 2) return -1;
 
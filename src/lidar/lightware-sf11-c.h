@@ -0,0 +1,26 @@
+#pragma once
+
+#include "common.h"
+
+// The I2C address of the lidar is preset to 0x55
+#ifndef LIDAR_SF11_I2C_ADDR
+#define LIDAR_SF11_I2C_ADDR 0x55
+#endif
+
+// The SF11/C updates its distance 20 times per second
+#ifndef LIDAR_SF11_PERIOD_MS
+#define LIDAR_SF11_PERIOD_MS 50
+#endif
+
+/**
+ * Lightware SF11/C, in I²C mode. It measures continuously, so reading returns the latest distance.
+ */
+class LightwareSF11 : public Lidar {
+public:
+	using Lidar::Lidar;
+
+	bool setup() override;
+	void trigger() override;
+	int16_t read_distance_cm() override;
+	uint16_t period_ms() const override { return LIDAR_SF11_PERIOD_MS; }
+};
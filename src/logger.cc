@@ -0,0 +1,323 @@
+#include "logger.h"
+
+#include <SD.h>
+
+#include "debug.h"
+#include "lidar/common.h"
+#include "realign.h"
+#include "sampler.h"
+
+// Not FILE_WRITE: with O_APPEND, the untimed rows could not be patched in place
+#define LOG_FILE_MODE (O_READ | O_WRITE | O_CREAT)
+
+// the full-rate raw stream and the 1 Hz summary
+static File raw_file;
+static File summary_file;
+
+static unsigned long last_raw_flush = 0;
+
+static Realignment raw_realignment(ROW_RAW);
+static Realignment summary_realignment(ROW_TEXT);
+
+/**
+ * Running sums for the summary row being built. The GPS fields are taken from the last sample, as the receiver only
+ * updates once per second anyway.
+ */
+static struct {
+	uint16_t count;
+	uint32_t first_ms;
+	Sample last;
+
+	uint16_t lidar_count[LIDAR_COUNT];
+	int32_t lidar_sum[LIDAR_COUNT];
+
+	float tilt_deg;
+	float accel_x, accel_y, accel_z;
+	float gyro_x, gyro_y, gyro_z;
+} summary;
+
+/**
+ * Writes a log number into a file name.
+ *
+ * \param[out] filename The file name.
+ * \param      digits   The index of the first of the four digits.
+ * \param      number   The number.
+ */
+static void set_file_number(char *filename, size_t digits, u16 number) {
+	filename[digits] = number / 1000 + '0';
+	filename[digits + 1] = (number % 1000) / 100 + '0';
+	filename[digits + 2] = (number % 100) / 10 + '0';
+	filename[digits + 3] = number % 10 + '0';
+}
+
+/**
+ * Opens a new pair of log files, numbering them with the first number for which neither file exists. An existing log
+ * is never overwritten, even when the other file of its pair was removed.
+ */
+static void open_next_files() {
+	char summary_name[] = "LOG_0000.CSV";
+	char raw_name[] = "LOG_0000.BIN";
+
+	for(u16 i = 0; i < 10000; i++) {
+		set_file_number(summary_name, 4, i);
+		set_file_number(raw_name, 4, i);
+
+		DEBUG(summary_name);
+		DEBUG(' ');
+
+		// Only open new files if neither exists
+		if(!SD.exists(summary_name) && !SD.exists(raw_name)) {
+			summary_file = SD.open(summary_name, LOG_FILE_MODE);
+			raw_file = SD.open(raw_name, LOG_FILE_MODE);
+			DEBUGLN(F("is available"));
+
+			return;
+		}
+		DEBUGLN(F("already exists."));
+	}
+}
+
+bool setup_logger() {
+	// The raw stream shares the number of the summary, so the pair is easy to match
+	open_next_files();
+	if(!summary_file || !raw_file) return false;
+
+	summary_file.println(F("# GPS and Laser Rangefinder logging with Pro Micro Arduino 3.3v"));
+	summary_file.println(F("# units:  accel=1g  gyro=deg/sec"));
+	summary_file.println(F("# one row per second: GPS from the last sample, sensors averaged over the second"));
+	summary_file.println(F("# rows logged without a fix are dated from boot_ms, the boot clock, once the fix returns"));
+	summary_file.println(F("# the sampling rate follows the climb and rotation rates, each change is noted as a comment"));
+
+	summary_file.print(F("#gmt_date\tgmt_time\tnum_sats\tlongitude\tlatitude\t"));
+	summary_file.print(F("gps_altitude_m\tSOG_kt\tCOG\tHDOP\tlaser_altitude_cm\t"));
+	for(size_t i = 1; i < LIDAR_COUNT; i++) {
+		summary_file.print(F("laser"));
+		summary_file.print(i + 1);
+		summary_file.print(F("_altitude_cm\t"));
+	}
+	summary_file.println(F("tilt_deg\taccel_x\taccel_y\taccel_z\tgyro_x\tgyro_y\tgyro_z\textrap_age_ms\tboot_ms"));
+	summary_file.flush();
+
+	RawLogHeader header;
+	memcpy(header.magic, RAW_LOG_MAGIC, sizeof(header.magic));
+	header.version = RAW_LOG_VERSION;
+	header.record_size = sizeof(Sample);
+	raw_file.write((const uint8_t *) &header, sizeof(header));
+	raw_file.flush();
+
+	summary.count = 0;
+	last_raw_flush = millis();
+
+	return true;
+}
+
+/**
+ * Writes the summary row built so far and starts a new one.
+ */
+static void write_summary() {
+	Sample &row = summary.last;
+	float count = summary.count;
+
+	for(size_t i = 0; i < LIDAR_COUNT; i++) {
+		if(summary.lidar_count[i] > 0)
+			row.lidar_cm[i] = (summary.lidar_sum[i] + summary.lidar_count[i] / 2) / summary.lidar_count[i];
+		else
+			row.lidar_cm[i] = -1;
+	}
+
+	row.tilt_deg = summary.tilt_deg / count;
+	row.accel_x = summary.accel_x / count;
+	row.accel_y = summary.accel_y / count;
+	row.accel_z = summary.accel_z / count;
+	row.gyro_x = summary.gyro_x / count;
+	row.gyro_y = summary.gyro_y / count;
+	row.gyro_z = summary.gyro_z / count;
+
+	summary_realignment.track(summary_file, summary_file.position(), row);
+	write_data_line(summary_file, row);
+	summary_realignment.step(summary_file, SUMMARY_REALIGN_BUDGET);
+	summary_file.flush();
+
+	summary.count = 0;
+}
+
+void log_sample(const Sample &sample) {
+	TXLED1;  // The Tx LED is not tied to a normally controlled pin so we use this macro
+
+	raw_realignment.track(raw_file, raw_file.position(), sample);
+	raw_file.write((const uint8_t *) &sample, sizeof(sample));
+	raw_realignment.step(raw_file, RAW_REALIGN_BUDGET);
+	if(millis() - last_raw_flush >= RAW_FLUSH_PERIOD_MS) {
+		raw_file.flush();
+		last_raw_flush = millis();
+	}
+
+	if(summary.count > 0 && sample.boot_ms - summary.first_ms >= SUMMARY_PERIOD_MS)
+		write_summary();
+
+	if(summary.count == 0) {
+		summary.first_ms = sample.boot_ms;
+		for(size_t i = 0; i < LIDAR_COUNT; i++) {
+			summary.lidar_count[i] = 0;
+			summary.lidar_sum[i] = 0;
+		}
+		summary.tilt_deg = 0;
+		summary.accel_x = summary.accel_y = summary.accel_z = 0;
+		summary.gyro_x = summary.gyro_y = summary.gyro_z = 0;
+	}
+
+	summary.count++;
+	summary.last = sample;
+
+	for(size_t i = 0; i < LIDAR_COUNT; i++) {
+		if(sample.lidar_cm[i] != -1) {
+			summary.lidar_count[i]++;
+			summary.lidar_sum[i] += sample.lidar_cm[i];
+		}
+	}
+
+	summary.tilt_deg += sample.tilt_deg;
+	summary.accel_x += sample.accel_x;
+	summary.accel_y += sample.accel_y;
+	summary.accel_z += sample.accel_z;
+	summary.gyro_x += sample.gyro_x;
+	summary.gyro_y += sample.gyro_y;
+	summary.gyro_z += sample.gyro_z;
+
+	TXLED0;
+}
+
+void log_sampling_change(uint32_t boot_ms) {
+	Stream &stream = summary_file;
+
+	stream.print(F("# sampling "));
+	switch(get_sampling_level()) {
+		case SAMPLING_FLOOR: stream.print(F("floor")); break;
+		case SAMPLING_NORMAL: stream.print(F("normal")); break;
+		case SAMPLING_BURST: stream.print(F("burst")); break;
+	}
+	stream.print(F(" every "));
+	stream.print(get_sampling_interval_ms());
+	stream.print(F(" ms from boot_ms "));
+	stream.print(boot_ms);
+	stream.print(F(": climb "));
+	stream.print(get_climb_rate_cm_s());
+	stream.print(F(" cm/s, rotation "));
+	stream.print(get_rotation_rate_dps());
+	stream.println(F(" deg/s"));
+
+	DEBUG(F("Sampling every "));
+	DEBUG(get_sampling_interval_ms());
+	DEBUGLN(F(" ms"));
+}
+
+/**
+ * Prints a fixed-point number.
+ *
+ * \param stream   The `Stream` to write to.
+ * \param value    The number, scaled by 10^decimals.
+ * \param decimals The number of digits after the decimal point.
+ */
+static void print_fixed(Stream &stream, int32_t value, uint8_t decimals) {
+	if(value < 0) {
+		stream.print('-');
+		value = -value;
+	}
+
+	if(decimals == 0) {
+		stream.print(value);
+		return;
+	}
+
+	int32_t scale = 1;
+	for(uint8_t i = 0; i < decimals; i++) scale *= 10;
+
+	stream.print(value / scale);
+	stream.print('.');
+
+	int32_t fraction = value % scale;
+	for(int32_t digit = scale / 10; digit > 1 && fraction < digit; digit /= 10)
+		stream.print('0');
+	stream.print(fraction);
+}
+
+#define __WRITE_SAMPLE_MEASURE__(stream, sample, flag, value, decimals) { \
+	if(sample.flags & flag) print_fixed(stream, sample.value, decimals); \
+	else stream.print(F("NaN")); \
+	stream.print(F("\t")); \
+}
+
+void write_data_line(Stream &stream, const Sample &sample) {
+	if(sample.flags & SAMPLE_DATE_VALID) {
+		stream.print(sample.year);
+		stream.print(F("/"));
+		if(sample.month < 10) stream.print(F("0"));
+		stream.print(sample.month);
+		stream.print(F("/"));
+		if(sample.day < 10) stream.print(F("0"));
+		stream.print(sample.day);
+	} else {
+		stream.print(F(UNTIMED_DATE));
+	}
+	stream.print(F("\t"));
+	if(sample.flags & SAMPLE_TIME_VALID) {
+		if(sample.hour < 10) stream.print(F("0"));
+		stream.print(sample.hour);
+		stream.print(F(":"));
+		if(sample.minute < 10) stream.print(F("0"));
+		stream.print(sample.minute);
+		stream.print(F(":"));
+		if(sample.second < 10) stream.print(F("0"));
+		stream.print(sample.second);
+	} else {
+		stream.print(F(UNTIMED_TIME));
+	}
+	stream.print(F("\t"));
+
+	stream.print(sample.num_sats);
+	stream.print(F("\t"));
+	if(sample.flags & SAMPLE_LOCATION_VALID) {
+		// Printed with 6 decimals, as 1e-6 * 1852 * 60 = 0.11 meters is already below the receiver's accuracy
+		print_fixed(stream, (sample.longitude_e7 + (sample.longitude_e7 < 0 ? -5 : 5)) / 10, 6);
+		stream.print(F("\t"));
+		print_fixed(stream, (sample.latitude_e7 + (sample.latitude_e7 < 0 ? -5 : 5)) / 10, 6);
+	} else {
+		stream.print(F("NaN\tNaN"));
+	}
+	stream.print(F("\t"));
+
+	__WRITE_SAMPLE_MEASURE__(stream, sample, SAMPLE_ALTITUDE_VALID, gps_altitude_cm, 2);
+	__WRITE_SAMPLE_MEASURE__(stream, sample, SAMPLE_SPEED_VALID, speed_ckn, 2);
+	__WRITE_SAMPLE_MEASURE__(stream, sample, SAMPLE_COURSE_VALID, course_cdeg, 2);
+	__WRITE_SAMPLE_MEASURE__(stream, sample, SAMPLE_HDOP_VALID, hdop, 0);
+
+	for(size_t i = 0; i < LIDAR_COUNT; i++) {
+		if(sample.lidar_cm[i] == -1) stream.print(F("NaN"));
+		else stream.print(sample.lidar_cm[i]);
+		stream.print(F("\t"));
+	}
+
+	stream.print(sample.tilt_deg, 2);
+	stream.print(F("\t"));
+	stream.print(sample.accel_x, 4);
+	stream.print(F("\t"));
+	stream.print(sample.accel_y, 4);
+	stream.print(F("\t"));
+	stream.print(sample.accel_z, 4);
+	stream.print(F("\t"));
+	stream.print(sample.gyro_x, 3);
+	stream.print(F("\t"));
+	stream.print(sample.gyro_y, 3);
+	stream.print(F("\t"));
+	stream.print(sample.gyro_z, 3);
+	stream.print(F("\t"));
+
+	if(sample.flags & SAMPLE_LOCATION_VALID) stream.print(sample.extrap_age_ms);
+	else stream.print(F("NaN"));
+	stream.print(F("\t"));
+
+	stream.print(sample.boot_ms);
+	stream.println();
+}
+
+#undef __WRITE_SAMPLE_MEASURE__
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "sample.h"
+
+/*
+The logger writes to two sinks at the same time:
+ - LOG_XXXX.BIN receives every sample, as raw `Sample` records, at the rate picked by the sampler;
+ - LOG_XXXX.CSV receives one row per second, with the sensor readings averaged over that second.
+*/
+
+// How long a summary row aggregates, in milliseconds
+#define SUMMARY_PERIOD_MS 1000
+
+// How often the raw stream is flushed to the card, in milliseconds
+#define RAW_FLUSH_PERIOD_MS 5000
+
+// How much of an outage is realigned per logged row: in samples for the raw stream, in bytes for the summary
+#define RAW_REALIGN_BUDGET 4
+#define SUMMARY_REALIGN_BUDGET 512
+
+/**
+ * Creates a new pair of log files on the SD card and writes their headers. `SD.begin()` must have been called.
+ *
+ * @return Whether both files were created.
+ */
+bool setup_logger();
+
+/**
+ * Appends a sample to the raw stream and folds it into the current summary row. The summary row is written once
+ * `SUMMARY_PERIOD_MS` has elapsed since its first sample.
+ *
+ * \param sample The sample to log.
+ */
+void log_sample(const Sample &sample);
+
+/**
+ * Notes a change of the sampling level in the summary, as a comment line. The raw stream needs none, each sample holds
+ * its level.
+ *
+ * \param boot_ms The time of the change.
+ */
+void log_sampling_change(uint32_t boot_ms);
+
+/**
+ * Writes a sample as a tab-separated row, in the layout described by the CSV header. A sample without date and time
+ * gets the fixed-width placeholders of realign.h.
+ *
+ * \param stream The `Stream` to write to.
+ * \param sample The sample to write.
+ */
+void write_data_line(Stream &stream, const Sample &sample);
@@ -7,8 +7,14 @@
 
 #include "lidar/common.h"
 #include "gps/common.h"
+#include "gps/dead-reckoning.h"
 #include "debug.h"
 #include "imu.h"
+#include "logger.h"
+#include "sample.h"
+#include "sampler.h"
+#include "sd-bench.h"
+#include "telemetry.h"
 
 // SDcard SPI pins
 #define SPI_CS  10
@@ -21,12 +27,10 @@ enum ErrorType {
 	ERR_NO_GPS_LOCK,
 	ERR_IMU_FAIL,
 	ERR_SD_FAIL,
-	ERR_SD_CREATE_FAIL
+	ERR_SD_CREATE_FAIL,
+	ERR_SD_TOO_SLOW
 };
 
-// the logging file
-static File logfile;
-
 /**
  * Captures the execution of the program and report the status. The report is done through the RX_LED by blinking.
  * 
@@ -72,6 +76,9 @@ void fat_datetime_callback(uint16_t *date, uint16_t *time) {
 }
 
 void setup() {
+	// The benchmark button is held at power on, read it before the sensors take their time to start
+	bool sd_bench_requested = is_sd_bench_requested();
+
 	// We start the serial object even without debug, or the IMU doesn't work
 	Serial.begin(115200);
 
@@ -87,9 +94,11 @@ void setup() {
 	delay(1000);
 #endif
 
-	if(!setup_lidar()) {
-		DEBUGLN(F("LiDAR error. Halting."));
-		lock_and_report_error(ERR_NO_LIDAR);
+	for(size_t i = 0; i < LIDAR_COUNT; i++) {
+		if(!lidars[i]->setup()) {
+			DEBUGLN(F("LiDAR error. Halting."));
+			lock_and_report_error(ERR_NO_LIDAR);
+		}
 	}
 
 	if(!setup_gps()) {
@@ -103,6 +112,20 @@ void setup() {
 	}
 	imu.enableDefault();
 
+	// qualify the card before using it, when asked to
+	if(sd_bench_requested) {
+		SdBenchResult result = run_sd_bench(SPI_CS);
+
+		if(result == SD_BENCH_CARD_ERROR) {
+			DEBUGLN(F("SD card error. Halting."));
+			lock_and_report_error(ERR_SD_FAIL);
+		}
+		if(result == SD_BENCH_REJECTED) {
+			DEBUGLN(F("SD card too slow. Halting."));
+			lock_and_report_error(ERR_SD_TOO_SLOW);
+		}
+	}
+
 	// see if the card is present and can be initialised
 	if(!SD.begin(SPI_CS)) {
 		DEBUGLN(F("SD card error. Halting."));
@@ -114,42 +137,15 @@ void setup() {
 	// set SD file date time callback function
 	SdFile::dateTimeCallback(fat_datetime_callback);
 
-	// create a new file
-	char filename[] = "LOG_0000.CSV";
-	for(u16 i = 0; i < 10000; i++) {
-		filename[4] = i / 1000 + '0';
-		filename[5] = (i % 1000) / 100 + '0';
-		filename[6] = (i % 100) / 10 + '0';
-		filename[7] = i % 10 + '0';
-
-		DEBUG(filename);
-		DEBUG(' ');
-
-		// Only open a new file if it doesn't exist
-		if(!SD.exists(filename)) {
-			// We consume the GPS data so we can set the creation date of the file
-			logfile = SD.open(filename, FILE_WRITE);
-			DEBUGLN(F("is available"));
-
-			break;
-		}
-		DEBUGLN(F("already exists."));
-	}
+	// create the log files
+	bool logger_ready = setup_logger();
 
 	wakeful_delay(500);  // give it a chance to catch up before testing if it's ok.
-	if(!logfile) {
-		DEBUGLN(F("ERROR: couldn't create log file. Halting."));
+	if(!logger_ready) {
+		DEBUGLN(F("ERROR: couldn't create log files. Halting."));
 		lock_and_report_error(ERR_SD_CREATE_FAIL);
 	}
 
-	logfile.println(F("# GPS and Laser Rangefinder logging with Pro Micro Arduino 3.3v"));
-	logfile.println(F("# units:  accel=1g  gyro=deg/sec"));
-
-	logfile.print(F("#gmt_date\tgmt_time\tnum_sats\tlongitude\tlatitude\t"));
-	logfile.print(F("gps_altitude_m\tSOG_kt\tCOG\tHDOP\tlaser_altitude_cm\t"));
-	logfile.println(F("tilt_deg\taccel_x\taccel_y\taccel_z\tgyro_x\tgyro_y\tgyro_z"));
-	logfile.flush();
-
 	// Should we wait a while for GPS to get a fix?
 	wakeful_delay(2000);
 
@@ -164,142 +160,123 @@ void setup() {
 	}
 }
 
-#define __WRITE_GPS_MEASURE__(gps, stream, property, accessor) { \
-	if(gps.property.isValid()) stream.print(gps.property.accessor()); \
-	else stream.print(F("NaN")); \
-	stream.print(F("\t")); \
+/**
+ * Converts a coordinate returned by TinyGPS++ into fixed-point.
+ *
+ * \param raw The coordinate.
+ * \return the coordinate in degrees * 10^7
+ */
+int32_t raw_degrees_e7(const RawDegrees &raw) {
+	int32_t value = raw.deg * 10000000L + (raw.billionths + 50) / 100;
+	return raw.negative ? -value : value;
 }
 
 /**
- * \param stream         The `Stream` to write to.
- * \param lidar_distance The distance read by the lidar, in centimetres.
- * \param imu_results    The results returned by the innertial mesurement unit.
+ * Captures the last GPS result along with the sensor readings.
+ *
+ * \param[out] sample          The sample to fill.
+ * \param      lidar_distances The distance read by each lidar, in centimetres.
+ * \param      imu_results     The results returned by the innertial mesurement unit.
  */
-void write_data_line(Stream &stream, int16_t lidar_distance, const struct IMUData &imu_results, bool report_writing = false) {
-	if(report_writing) TXLED1;  // The Tx LED is not tied to a normally controlled pin so we use this macro
-
-	if(gps.date.isValid()) {
-		u16 year = gps.date.year();
-		u8 month = gps.date.month();
-		u8 day = gps.date.day();
-		stream.print(year);
-		stream.print(F("/"));
-		if(month < 10) stream.print(F("0"));
-		stream.print(month);
-		stream.print(F("/"));
-		if(day < 10) stream.print(F("0"));
-		stream.print(day);
-	} else {
-		stream.print(F("INVALID"));
-	}
-	stream.print(F("\t"));
-	if(gps.time.isValid()) {
-		u8 hour = gps.time.hour();
-		u8 minute = gps.time.minute();
-		u8 second = gps.time.second();
-		if(hour < 10) stream.print(F("0"));
-		stream.print(hour);
-		stream.print(F(":"));
-		if(minute < 10) stream.print(F("0"));
-		stream.print(minute);
-		stream.print(F(":"));
-		if(second < 10) stream.print(F("0"));
-		stream.print(second);
-	} else {
-		stream.print(F("INVALID"));
+void capture_sample(Sample &sample, const int16_t lidar_distances[LIDAR_COUNT], const struct IMUData &imu_results) {
+	sample.boot_ms = millis();
+	sample.flags = 0;
+
+	// Rows logged during an outage are left undated, to be realigned with the boot clock once the fix returns
+	if(gps.date.isValid() && gps.date.age() <= GPS_FIX_TIMEOUT_MS) {
+		sample.flags |= SAMPLE_DATE_VALID;
+		sample.year = gps.date.year();
+		sample.month = gps.date.month();
+		sample.day = gps.date.day();
 	}
-	stream.print(F("\t"));
-
-	stream.print(gps.satellites.value());
-	stream.print(F("\t"));
-	if(gps.location.isValid()) {
-		// The latitude and longitude floating point values are restricted to 32bit precision; so a total of 7 or 8
-		// significant digits including those before the decimal point (1e-5 * 1852 * 60 = 1.11 meters)
-		stream.print(gps.location.lng(), 6);
-		stream.print(F("\t"));
-		stream.print(gps.location.lat(), 6);
-	} else {
-		stream.print(F("NaN\tNaN"));
+	if(gps.time.isValid() && gps.time.age() <= GPS_FIX_TIMEOUT_MS) {
+		sample.flags |= SAMPLE_TIME_VALID;
+		sample.hour = gps.time.hour();
+		sample.minute = gps.time.minute();
+		sample.second = gps.time.second();
+		sample.centisecond = gps.time.centisecond();
+		sample.time_age_ms = gps.time.age();
 	}
-	stream.print(F("\t"));
-	
-	__WRITE_GPS_MEASURE__(gps, stream, altitude, meters);
-	__WRITE_GPS_MEASURE__(gps, stream, speed, knots);
-	__WRITE_GPS_MEASURE__(gps, stream, course, deg);
-	__WRITE_GPS_MEASURE__(gps, stream, hdop, value);
-	
-	if(lidar_distance == -1) stream.print(F("NaN"));
-	else stream.print(lidar_distance);
-	stream.print(F("\t"));
-	
-	stream.print(imu_results.tilt_deg, 2);
-	stream.print(F("\t"));
-	stream.print(imu_results.accel_x, 4);
-	stream.print(F("\t"));
-	stream.print(imu_results.accel_y, 4);
-	stream.print(F("\t"));
-	stream.print(imu_results.accel_z, 4);
-	stream.print(F("\t"));
-	stream.print(imu_results.gyro_x, 3);
-	stream.print(F("\t"));
-	stream.print(imu_results.gyro_y, 3);
-	stream.print(F("\t"));
-	stream.print(imu_results.gyro_z, 3);
-	stream.println();
-
-	if(report_writing) TXLED0;
-}
 
-#undef __WRITE_GPS_MEASURE__
+	sample.num_sats = gps.satellites.value();
 
-void loop(void) {
-	// IMU
-	IMUData imu_results;
+	// TinyGPS++ keeps the last fix valid forever. The position, and the speed and course it is extrapolated with, are
+	// kept for as long as dead reckoning bridges; past that, and past GPS_FIX_TIMEOUT_MS for the rest, they are missing.
+	if(gps.location.isValid() && gps.location.age() <= DEAD_RECKONING_MAX_AGE_MS) {
+		sample.flags |= SAMPLE_LOCATION_VALID;
+		sample.longitude_e7 = raw_degrees_e7(gps.location.rawLng());
+		sample.latitude_e7 = raw_degrees_e7(gps.location.rawLat());
+		sample.fix_age_ms = min(gps.location.age(), 0xFFFFUL);
+	}
+	if(gps.altitude.isValid() && gps.altitude.age() <= GPS_FIX_TIMEOUT_MS) {
+		sample.flags |= SAMPLE_ALTITUDE_VALID;
+		sample.gps_altitude_cm = gps.altitude.value();
+	}
+	if(gps.speed.isValid() && gps.speed.age() <= DEAD_RECKONING_MAX_AGE_MS) {
+		sample.flags |= SAMPLE_SPEED_VALID;
+		sample.speed_ckn = gps.speed.value();
+	}
+	if(gps.course.isValid() && gps.course.age() <= DEAD_RECKONING_MAX_AGE_MS) {
+		sample.flags |= SAMPLE_COURSE_VALID;
+		sample.course_cdeg = gps.course.value();
+	}
+	if(gps.hdop.isValid() && gps.hdop.age() <= GPS_FIX_TIMEOUT_MS) {
+		sample.flags |= SAMPLE_HDOP_VALID;
+		sample.hdop = gps.hdop.value();
+	}
 
-	// get GPS string
-	consume_gps();
+	dead_reckon(sample);
 
-	// Output row without GPS data every 5 sec if no fix
-	if(!gps.date.isUpdated() || gps.location.age() > 1750) {
-		unsigned long first_detected = millis();
-		unsigned long next_signal = 5000;
+	for(size_t i = 0; i < MAX_LIDARS; i++)
+		sample.lidar_cm[i] = i < LIDAR_COUNT ? lidar_distances[i] : -1;
 
-		while(!gps.date.isUpdated() || gps.location.age() > 1750) {
-			consume_gps();
-			unsigned long delta_t = millis() - first_detected;
+	sample.tilt_deg = imu_results.tilt_deg;
+	sample.accel_x = imu_results.accel_x;
+	sample.accel_y = imu_results.accel_y;
+	sample.accel_z = imu_results.accel_z;
+	sample.gyro_x = imu_results.gyro_x;
+	sample.gyro_y = imu_results.gyro_y;
+	sample.gyro_z = imu_results.gyro_z;
 
-			if(delta_t > next_signal) {
-				int16_t lidar_distance = get_lidar_distance_cm();
+	sample.sampling_level = get_sampling_level();
+}
 
-				get_imu_readings(imu_results);
+void loop(void) {
+	static unsigned long last_sample_ms = 0;
 
-#ifdef DEBUG_DATA
-				// Printout to USB-serial
-				if(DEBUG_STREAM)
-					write_data_line(DEBUG_STREAM, lidar_distance, imu_results);
-#endif
-				write_data_line(logfile, lidar_distance, imu_results, true);
-				logfile.flush();
+	// IMU
+	IMUData imu_results;
+	Sample sample;
 
-				next_signal += 5000;
-			}
-		}
-	}
+	// wait for the next sample at the rate picked by the sampler, still reading the GPS
+	unsigned long elapsed = millis() - last_sample_ms;
+	if(elapsed < get_sampling_interval_ms()) wakeful_delay(get_sampling_interval_ms() - elapsed);
+	last_sample_ms = millis();
 
-	get_imu_readings(imu_results);
+	// get GPS string
+	consume_gps();
+
+	// Sampling goes on at the same rate without a fix; the rows are dated once it returns. The lidars are sampled at
+	// their own rates while the IMU is read, over the same window.
+	get_imu_readings(imu_results, get_imu_sample_count(), poll_lidars);
 
 	// update gps data available scan again to clear the decks
 	consume_gps();
 
-	int16_t lidar_distance = get_lidar_distance_cm();
+	int16_t lidar_distances[LIDAR_COUNT];
+	read_lidars(lidar_distances);
+	capture_sample(sample, lidar_distances, imu_results);
+	send_telemetry(sample);
 
 #ifdef DEBUG_DATA
 	// Printout to USB-serial
 	if(DEBUG_STREAM)
-		write_data_line(DEBUG_STREAM, lidar_distance, imu_results);
+		write_data_line(DEBUG_STREAM, sample);
 #endif
 
 	// write to SD card
-	write_data_line(logfile, lidar_distance, imu_results, true);
-	logfile.flush();
+	log_sample(sample);
+
+	// pick the rate of the next samples
+	if(update_sampler(sample)) log_sampling_change(sample.boot_ms);
 }
@@ -0,0 +1,176 @@
+#include "realign.h"
+
+#include <stddef.h>
+
+#define TIMED (SAMPLE_DATE_VALID | SAMPLE_TIME_VALID)
+#define SECONDS_PER_DAY 86400UL
+
+/*
+Conversion between dates and days since 2000-01-01, from Howard Hinnant's `days_from_civil` and `civil_from_days`.
+Years start in March so the leap day is the last of the year.
+*/
+
+static uint32_t days_from_civil(uint16_t year, uint8_t month, uint8_t day) {
+	int32_t y = year - (month <= 2);
+	int32_t era = y / 400;
+	int32_t year_of_era = y - era * 400;
+	int32_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	int32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+	return era * 146097 + day_of_era - 730425;
+}
+
+static void civil_from_days(uint32_t days, uint16_t &year, uint8_t &month, uint8_t &day) {
+	int32_t z = days + 730425;
+	int32_t era = z / 146097;
+	int32_t day_of_era = z - era * 146097;
+	int32_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+	int32_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+	int32_t shifted_month = (5 * day_of_year + 2) / 153;
+
+	day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+	month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+	year = year_of_era + era * 400 + (month <= 2);
+}
+
+void Realignment::track(File &file, uint32_t position, const Sample &row) {
+	if((row.flags & TIMED) != TIMED) {
+		if(!in_outage) {
+			in_outage = true;
+			outage_start = position;
+		}
+		return;
+	}
+
+	if(!in_outage) return;
+
+	// Rare: the previous outage is not patched yet. It is finished now, as only one can be tracked.
+	while(active) step(file, 0xFFFF);
+
+	in_outage = false;
+	active = true;
+	this->position = line_start = outage_start;
+	end = position;
+	line_untimed = false;
+	line_boot_ms = 0;
+
+	// The date and time are as old as the sentence they came from, which is not always the one of the position
+	anchor_boot_ms = row.boot_ms - row.time_age_ms;
+	anchor_utc_s = days_from_civil(row.year, row.month, row.day) * SECONDS_PER_DAY
+		+ row.hour * 3600UL + row.minute * 60UL + row.second;
+	anchor_utc_ms = row.centisecond * 10;
+}
+
+/**
+ * Dates a row from the anchor.
+ */
+static void date_row(Sample &row, uint32_t anchor_boot_ms, uint32_t anchor_utc_s, uint16_t anchor_utc_ms) {
+	uint32_t delta = anchor_boot_ms - row.boot_ms;
+	uint32_t seconds = anchor_utc_s - delta / 1000;
+	int16_t milliseconds = anchor_utc_ms - (int16_t) (delta % 1000);
+	if(milliseconds < 0) {
+		milliseconds += 1000;
+		seconds--;
+	}
+
+	// The fields of the packed Sample cannot be bound to references
+	uint16_t year;
+	uint8_t month, day;
+	civil_from_days(seconds / SECONDS_PER_DAY, year, month, day);
+	row.year = year;
+	row.month = month;
+	row.day = day;
+
+	uint32_t second_of_day = seconds % SECONDS_PER_DAY;
+	row.hour = second_of_day / 3600;
+	row.minute = (second_of_day / 60) % 60;
+	row.second = second_of_day % 60;
+	row.centisecond = milliseconds / 10;
+	row.flags |= TIMED | SAMPLE_TIME_REALIGNED;
+}
+
+void Realignment::step(File &file, uint16_t budget) {
+	if(!active) return;
+
+	file.seek(position);
+	for(uint16_t i = 0; i < budget && active; i++)
+		active = format == ROW_RAW ? step_raw(file) : step_text(file);
+
+	file.seek(file.size());
+}
+
+/**
+ * Patches one Sample record.
+ *
+ * @return whether there are rows left
+ */
+bool Realignment::step_raw(File &file) {
+	if(position >= end) return false;
+
+	// boot_ms, then flags and the date and time, which are contiguous
+	Sample row;
+	file.seek(position);
+	if(file.read((uint8_t *) &row, offsetof(Sample, num_sats)) == offsetof(Sample, num_sats)
+			&& (row.flags & TIMED) != TIMED) {
+		date_row(row, anchor_boot_ms, anchor_utc_s, anchor_utc_ms);
+		file.seek(position + offsetof(Sample, flags));
+		file.write(&row.flags, offsetof(Sample, num_sats) - offsetof(Sample, flags));
+	}
+
+	position += sizeof(Sample);
+	return position < end;
+}
+
+/**
+ * Reads one byte of the CSV, patching the line it ends if it is untimed.
+ *
+ * @return whether there are rows left
+ */
+bool Realignment::step_text(File &file) {
+	if(position >= end) return false;
+
+	int c = file.read();
+	if(c < 0) return false;
+
+	if(position == line_start) line_untimed = c == UNTIMED_DATE[0];
+	position++;
+
+	if(c == '\t') {
+		line_boot_ms = 0;
+	} else if(c >= '0' && c <= '9') {
+		line_boot_ms = line_boot_ms * 10 + (c - '0');
+	} else if(c == '\n') {
+		if(line_untimed) {
+			Sample row;
+			row.boot_ms = line_boot_ms;
+			row.flags = 0;
+			date_row(row, anchor_boot_ms, anchor_utc_s, anchor_utc_ms);
+
+			// Same layout as write_data_line(): yyyy/mm/dd\thh:mm:ss
+			char text[] = "0000/00/00\t00:00:00";
+			text[0] += row.year / 1000;
+			text[1] += (row.year / 100) % 10;
+			text[2] += (row.year / 10) % 10;
+			text[3] += row.year % 10;
+			text[5] += row.month / 10;
+			text[6] += row.month % 10;
+			text[8] += row.day / 10;
+			text[9] += row.day % 10;
+			text[11] += row.hour / 10;
+			text[12] += row.hour % 10;
+			text[14] += row.minute / 10;
+			text[15] += row.minute % 10;
+			text[17] += row.second / 10;
+			text[18] += row.second % 10;
+
+			file.seek(line_start);
+			file.write((const uint8_t *) text, sizeof(text) - 1);
+			file.seek(position);
+		}
+
+		line_start = position;
+		line_boot_ms = 0;
+	}
+
+	return position < end;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <SD.h>
+
+#include "sample.h"
+
+/*
+Rows logged while the GPS has no fix have no date or time, only the boot clock. Once a fix returns it ties the boot
+clock to UTC, and the rows of the outage are revisited and given the UTC time their boot clock maps to. The files are
+patched in place a few rows at a time, so the logging never stalls on it.
+
+In the CSV, the untimed rows hold fixed-width `INVALID` placeholders so they can be overwritten in place. The boot
+clock is read from the last column of the row.
+*/
+
+// The date and time of an untimed row in the CSV, padded to the width of a real date and time
+#define UNTIMED_DATE "INVALID   "
+#define UNTIMED_TIME "INVALID "
+
+enum RowFormat {
+	ROW_RAW,  // Sample records
+	ROW_TEXT  // lines written by write_data_line()
+};
+
+/**
+ * Tracks the untimed rows of one log file and patches them.
+ */
+class Realignment {
+public:
+	explicit Realignment(RowFormat format) : format(format) {}
+
+	/**
+	 * Notes a row about to be written. A timed row following untimed ones starts their realignment.
+	 *
+	 * \param file     The file the row is written to.
+	 * \param position The position of the row in the file.
+	 * \param row      The row.
+	 */
+	void track(File &file, uint32_t position, const Sample &row);
+
+	/**
+	 * Patches some of the rows waiting to be realigned, then moves back to the end of the file.
+	 *
+	 * \param file   The file.
+	 * \param budget The number of rows, for the raw format, or bytes, for the text format, to go through.
+	 */
+	void step(File &file, uint16_t budget);
+
+private:
+	bool step_raw(File &file);
+	bool step_text(File &file);
+
+	const RowFormat format;
+
+	bool in_outage = false;
+	uint32_t outage_start;
+
+	// the rows left to patch, and the fix that dates them
+	bool active = false;
+	uint32_t position, end;
+	uint32_t anchor_boot_ms;
+	uint32_t anchor_utc_s;  // seconds since 2000-01-01
+	uint16_t anchor_utc_ms;
+
+	// state of the text scanner between steps
+	uint32_t line_start;
+	bool line_untimed;
+	uint32_t line_boot_ms;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <inttypes.h>
+
+/*
+A sample is everything captured in one pass of the loop. It is kept as a flat, packed structure so it can be written
+as-is to the raw binary log and read back by host-side tools; do not include any Arduino header here.
+*/
+
+// The raw log starts with a RawLogHeader followed by back-to-back Sample records
+#define RAW_LOG_MAGIC "LBXR"
+#define RAW_LOG_VERSION 6
+
+// Room for this many lidars is kept in every sample, whatever the build
+#define MAX_LIDARS 2
+
+enum SampleFlags {
+	SAMPLE_DATE_VALID     = 1 << 0,
+	SAMPLE_TIME_VALID     = 1 << 1,
+	SAMPLE_LOCATION_VALID = 1 << 2,
+	SAMPLE_ALTITUDE_VALID = 1 << 3,
+	SAMPLE_SPEED_VALID    = 1 << 4,
+	SAMPLE_COURSE_VALID   = 1 << 5,
+	SAMPLE_HDOP_VALID     = 1 << 6,
+	SAMPLE_TIME_REALIGNED = 1 << 7   // the date and time were derived from the boot clock after the outage
+};
+
+// The level picked by the adaptive sampler, see sampler.h
+enum SamplingLevel {
+	SAMPLING_FLOOR,
+	SAMPLING_NORMAL,
+	SAMPLING_BURST
+};
+
+struct __attribute__((packed)) Sample {
+	uint32_t boot_ms;  // millis() when the sample was taken
+	uint8_t flags;     // SampleFlags
+
+	uint16_t year;
+	uint8_t month, day;
+	uint8_t hour, minute, second, centisecond;
+
+	uint8_t num_sats;
+	int32_t longitude_e7, latitude_e7;  // degrees * 10^7
+	int32_t gps_altitude_cm;
+	uint16_t speed_ckn;    // knots * 100
+	uint16_t course_cdeg;  // degrees * 100
+	uint16_t hdop;         // HDOP * 100
+	uint16_t fix_age_ms;     // age of the last fix
+	uint16_t time_age_ms;    // age of the date and time, when SAMPLE_TIME_VALID
+	uint16_t extrap_age_ms;  // how far the position was extrapolated from the last fix, 0 when it was held
+
+	int16_t lidar_cm[MAX_LIDARS];  // -1 when the lidar could not be read, or is not fitted
+
+	float tilt_deg;
+	float accel_x, accel_y, accel_z;
+	float gyro_x, gyro_y, gyro_z;
+
+	uint8_t sampling_level;  // SamplingLevel the sample was taken at
+};
+
+struct __attribute__((packed)) RawLogHeader {
+	char magic[4];        // RAW_LOG_MAGIC, not null terminated
+	uint8_t version;      // RAW_LOG_VERSION
+	uint8_t record_size;  // sizeof(Sample)
+};
+
+static_assert(sizeof(Sample) == 71, "The raw log layout changed, bump RAW_LOG_VERSION");
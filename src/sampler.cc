@@ -0,0 +1,108 @@
+#include "sampler.h"
+
+#include <Arduino.h>
+
+// How fast the climb rate follows the lidar, in milliseconds: each delta weighs dt / (dt + SMOOTHING)
+#define CLIMB_RATE_SMOOTHING_MS 200
+
+static SamplingLevel level = SAMPLING_NORMAL;
+
+// the last distance measured and the lidar it came from, -1 for none
+static int8_t last_lidar = -1;
+static int16_t last_distance_cm;
+static uint32_t last_distance_ms;
+
+static bool climb_known = false;
+static int16_t climb_rate_cm_s = 0;
+static uint16_t rotation_rate_dps = 0;
+
+static uint32_t last_fast_ms;
+static uint32_t steady_since_ms;
+
+/**
+ * Folds the distance measured in a sample into the climb rate. The first lidar that could be read is used; the rate
+ * is forgotten when it changes, so the offset between two lidars is not taken for a climb.
+ *
+ * \param sample The sample.
+ */
+static void update_climb_rate(const Sample &sample) {
+	int8_t lidar = -1;
+	for(uint8_t i = 0; i < MAX_LIDARS; i++) {
+		if(sample.lidar_cm[i] != -1) {
+			lidar = i;
+			break;
+		}
+	}
+
+	if(lidar == -1 || lidar != last_lidar) {
+		climb_known = false;
+		climb_rate_cm_s = 0;
+	} else if(sample.boot_ms != last_distance_ms) {
+		uint32_t dt = min(sample.boot_ms - last_distance_ms, 60000UL);
+		int32_t rate = (int32_t) (sample.lidar_cm[lidar] - last_distance_cm) * 1000 / (int32_t) dt;
+		rate = constrain(rate, -30000, 30000);
+
+		if(!climb_known || dt >= 4 * CLIMB_RATE_SMOOTHING_MS)
+			climb_rate_cm_s = rate;
+		else
+			climb_rate_cm_s += (rate - climb_rate_cm_s) * (int32_t) dt / (int32_t) (dt + CLIMB_RATE_SMOOTHING_MS);
+		climb_known = true;
+	}
+
+	last_lidar = lidar;
+	if(lidar != -1) {
+		last_distance_cm = sample.lidar_cm[lidar];
+		last_distance_ms = sample.boot_ms;
+	}
+}
+
+bool update_sampler(const Sample &sample) {
+	update_climb_rate(sample);
+	rotation_rate_dps = sqrt(sq(sample.gyro_x) + sq(sample.gyro_y) + sq(sample.gyro_z)) + 0.5;
+
+	uint16_t climb = abs(climb_rate_cm_s);
+	bool fast = (climb_known && climb >= SAMPLER_FAST_CLIMB_CM_S) || rotation_rate_dps >= SAMPLER_FAST_ROTATION_DPS;
+	// Without a distance the airframe could be diving, it is never taken as steady
+	bool steady = climb_known && climb <= SAMPLER_STEADY_CLIMB_CM_S &&
+		rotation_rate_dps <= SAMPLER_STEADY_ROTATION_DPS;
+
+	if(fast) last_fast_ms = sample.boot_ms;
+	if(!steady) steady_since_ms = sample.boot_ms;
+
+	SamplingLevel next;
+	if(fast || (level == SAMPLING_BURST && sample.boot_ms - last_fast_ms < SAMPLER_BURST_HOLD_MS))
+		next = SAMPLING_BURST;
+	else if(sample.boot_ms - steady_since_ms >= SAMPLER_STEADY_HOLD_MS)
+		next = SAMPLING_FLOOR;
+	else
+		next = SAMPLING_NORMAL;
+
+	if(next == level) return false;
+
+	level = next;
+	return true;
+}
+
+SamplingLevel get_sampling_level() {
+	return level;
+}
+
+uint16_t get_sampling_interval_ms() {
+	switch(level) {
+		case SAMPLING_FLOOR: return SAMPLER_FLOOR_INTERVAL_MS;
+		case SAMPLING_BURST: return SAMPLER_BURST_INTERVAL_MS;
+		default: return SAMPLER_NORMAL_INTERVAL_MS;
+	}
+}
+
+uint8_t get_imu_sample_count() {
+	return level == SAMPLING_BURST ? SAMPLER_BURST_IMU_SAMPLES : 100;
+}
+
+int16_t get_climb_rate_cm_s() {
+	return climb_rate_cm_s;
+}
+
+uint16_t get_rotation_rate_dps() {
+	return rotation_rate_dps;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <inttypes.h>
+
+#include "sample.h"
+
+/*
+The loop is not run at a fixed rate. After each sample, the climb rate measured by the lidar and the rotation rate
+measured by the gyro pick one of three levels:
+ - burst, as soon as the distance to the surface or the attitude changes fast, held for a while after it calms down;
+ - floor, once both have been steady for a while;
+ - normal, in between.
+Each level sets the interval between samples and how many IMU readings are averaged into each of them.
+*/
+
+// Beyond either of these, the sampler switches to burst: climb rate in cm/s, rotation rate in °/s
+#ifndef SAMPLER_FAST_CLIMB_CM_S
+#define SAMPLER_FAST_CLIMB_CM_S 100
+#endif
+#ifndef SAMPLER_FAST_ROTATION_DPS
+#define SAMPLER_FAST_ROTATION_DPS 30
+#endif
+
+// Below both of these, the airframe is steady: climb rate in cm/s, rotation rate in °/s
+#ifndef SAMPLER_STEADY_CLIMB_CM_S
+#define SAMPLER_STEADY_CLIMB_CM_S 25
+#endif
+#ifndef SAMPLER_STEADY_ROTATION_DPS
+#define SAMPLER_STEADY_ROTATION_DPS 5
+#endif
+
+// How long burst is held after the last fast sample, and how long the airframe must be steady to drop to floor, in ms
+#ifndef SAMPLER_BURST_HOLD_MS
+#define SAMPLER_BURST_HOLD_MS 2000
+#endif
+#ifndef SAMPLER_STEADY_HOLD_MS
+#define SAMPLER_STEADY_HOLD_MS 5000
+#endif
+
+// The interval between samples at each level, in milliseconds
+#ifndef SAMPLER_FLOOR_INTERVAL_MS
+#define SAMPLER_FLOOR_INTERVAL_MS 1000
+#endif
+#ifndef SAMPLER_NORMAL_INTERVAL_MS
+#define SAMPLER_NORMAL_INTERVAL_MS 250
+#endif
+#ifndef SAMPLER_BURST_INTERVAL_MS
+#define SAMPLER_BURST_INTERVAL_MS 50
+#endif
+
+// The number of IMU readings averaged in burst; 100 readings take ~212ms, too long for the burst interval
+#ifndef SAMPLER_BURST_IMU_SAMPLES
+#define SAMPLER_BURST_IMU_SAMPLES 20
+#endif
+
+/**
+ * Updates the climb and rotation rates with a new sample and picks the level of the next one.
+ *
+ * \param sample The sample just taken.
+ * @return Whether the level changed.
+ */
+bool update_sampler(const Sample &sample);
+
+/**
+ * @return The current level.
+ */
+SamplingLevel get_sampling_level();
+
+/**
+ * @return The interval between samples at the current level, in milliseconds.
+ */
+uint16_t get_sampling_interval_ms();
+
+/**
+ * @return The number of IMU readings to average at the current level.
+ */
+uint8_t get_imu_sample_count();
+
+/**
+ * @return The smoothed climb rate, in cm/s, positive away from the surface. 0 when the lidars could not be read.
+ */
+int16_t get_climb_rate_cm_s();
+
+/**
+ * @return The rotation rate of the last sample, in °/s.
+ */
+uint16_t get_rotation_rate_dps();
@@ -0,0 +1,223 @@
+#include "sd-bench.h"
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include "debug.h"
+
+// Number of writes of each test
+#define SECTOR_WRITES 256
+#define APPENDED_ROWS 200
+
+// The histogram has power of two buckets: bucket i counts the latencies under 128 << i microseconds
+#define BUCKET_COUNT 16
+#define FIRST_BUCKET_US 128UL
+
+// The slowest latencies are kept exactly, enough of them for the p99 of every test
+#define SLOWEST_KEPT 2
+static_assert(SECTOR_WRITES / 100 <= SLOWEST_KEPT && APPENDED_ROWS / 100 <= SLOWEST_KEPT, "Keep more latencies");
+
+struct LatencyStats {
+	uint16_t count;
+	uint16_t errors;  // writes the card reported as failed, they are not timed
+	uint16_t buckets[BUCKET_COUNT];
+	uint32_t slowest_us[SLOWEST_KEPT];  // slowest first, the first one is the max
+};
+
+static void reset(LatencyStats &stats) {
+	memset(&stats, 0, sizeof(stats));
+}
+
+static void record(LatencyStats &stats, uint32_t latency_us) {
+	uint8_t bucket = 0;
+	while(bucket < BUCKET_COUNT - 1 && latency_us >= (FIRST_BUCKET_US << bucket)) bucket++;
+
+	stats.buckets[bucket]++;
+	stats.count++;
+
+	for(uint8_t i = 0; i < SLOWEST_KEPT; i++) {
+		if(latency_us > stats.slowest_us[i]) {
+			uint32_t swapped = stats.slowest_us[i];
+			stats.slowest_us[i] = latency_us;
+			latency_us = swapped;
+		}
+	}
+}
+
+/**
+ * Estimates the median from the histogram.
+ *
+ * @return the upper bound of the bucket holding the median, in microseconds
+ */
+static uint32_t median_us(const LatencyStats &stats) {
+	uint32_t rank = (stats.count + 1) / 2;
+	uint32_t seen = 0;
+
+	for(uint8_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+		seen += stats.buckets[bucket];
+		if(seen >= rank) return min(FIRST_BUCKET_US << bucket, stats.slowest_us[0]);
+	}
+
+	return stats.slowest_us[0];
+}
+
+/**
+ * @return the exact p99, the slowest latency fewer than 1 in 100 writes exceeded, in microseconds
+ */
+static uint32_t p99_us(const LatencyStats &stats) {
+	uint16_t rank = stats.count / 100;
+	return stats.slowest_us[rank > 0 ? rank - 1 : 0];
+}
+
+static void print_ms(Print &out, uint32_t us) {
+	out.print(us / 1000.0, 3);
+}
+
+static void report(Print &out, const __FlashStringHelper *name, const LatencyStats &stats) {
+	out.print(name);
+	out.print('\t');
+	out.print(stats.count);
+	out.print('\t');
+	print_ms(out, median_us(stats));
+	out.print('\t');
+	print_ms(out, p99_us(stats));
+	out.print('\t');
+	print_ms(out, stats.slowest_us[0]);
+	out.print('\t');
+	out.print(stats.errors);
+
+	for(uint8_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+		out.print('\t');
+		out.print(stats.buckets[bucket]);
+	}
+	out.println();
+}
+
+bool is_sd_bench_requested() {
+#ifdef SD_BENCHMARK
+	return true;
+#else
+	pinMode(SD_BENCH_BUTTON_PIN, INPUT_PULLUP);
+	delay(1);
+	return digitalRead(SD_BENCH_BUTTON_PIN) == LOW;
+#endif
+}
+
+SdBenchResult run_sd_bench(uint8_t chip_select) {
+	Sd2Card card;
+	SdVolume volume;
+	SdFile root;
+
+	if(!card.init(SPI_HALF_SPEED, chip_select) || !volume.init(&card) || !root.openRoot(&volume)) {
+		DEBUGLN(F("Benchmark: could not open the card"));
+		return SD_BENCH_CARD_ERROR;
+	}
+
+	LatencyStats sector_stats, stream_stats, append_stats;
+	reset(sector_stats);
+	reset(stream_stats);
+	reset(append_stats);
+
+	// Sector writes, straight to the blocks of a contiguous file so the file system is left intact
+	{
+		SdFile::remove(&root, "BENCH.DAT");
+
+		SdFile file;
+		uint32_t first_block, last_block;
+		if(!file.createContiguous(&root, "BENCH.DAT", SECTOR_WRITES * 512UL)
+				|| !file.contiguousRange(&first_block, &last_block)) {
+			DEBUGLN(F("Benchmark: could not preallocate BENCH.DAT"));
+			return SD_BENCH_CARD_ERROR;
+		}
+		file.close();
+
+		// The sectors are written from the block cache of the library, as there is no room for another 512 bytes. The
+		// cache is invalidated, so the file system does not take the pattern for a block it read.
+		uint8_t *buffer = SdVolume::cacheClear();
+		for(size_t i = 0; i < 512; i++) buffer[i] = i;
+
+		digitalWrite(LED_BUILTIN_RX, LOW);
+		for(uint32_t block = first_block; block <= last_block; block++) {
+			unsigned long start = micros();
+			if(card.writeBlock(block, buffer)) record(sector_stats, micros() - start);
+			else sector_stats.errors++;
+		}
+
+		// The same blocks again, as one multi-block write
+		if(card.writeStart(first_block, last_block - first_block + 1)) {
+			for(uint32_t block = first_block; block <= last_block; block++) {
+				unsigned long start = micros();
+				if(card.writeData(buffer)) {
+					record(stream_stats, micros() - start);
+				} else {
+					stream_stats.errors++;
+					break;  // the card leaves the multi-block write on an error
+				}
+			}
+			if(!card.writeStop()) stream_stats.errors++;
+		} else {
+			stream_stats.errors++;
+		}
+		digitalWrite(LED_BUILTIN_RX, HIGH);
+
+		SdFile::remove(&root, "BENCH.DAT");
+	}
+
+	// Appending rows the size of a log line, flushing after each one as the logger does
+	{
+		// The file is written through the block cache, the row needs its own buffer
+		uint8_t buffer[120];
+		for(size_t i = 0; i < sizeof(buffer); i++) buffer[i] = i;
+
+		SdFile file;
+		if(!file.open(&root, "BENCH.TMP", O_CREAT | O_WRITE | O_TRUNC)) {
+			DEBUGLN(F("Benchmark: could not create BENCH.TMP"));
+			return SD_BENCH_CARD_ERROR;
+		}
+
+		TXLED1;
+		for(uint16_t row = 0; row < APPENDED_ROWS; row++) {
+			unsigned long start = micros();
+			bool written = file.write(buffer, sizeof(buffer)) == sizeof(buffer);
+			written = file.sync() && written;
+			if(written) record(append_stats, micros() - start);
+			else append_stats.errors++;
+		}
+		TXLED0;
+
+		file.close();
+		SdFile::remove(&root, "BENCH.TMP");
+	}
+
+	// A card that fails a single write is not fit for logging, whatever its speed
+	bool passed = sector_stats.errors == 0 && stream_stats.errors == 0 && append_stats.errors == 0
+		&& append_stats.slowest_us[0] <= SD_BENCH_MAX_LATENCY_MS * 1000UL
+		&& p99_us(append_stats) <= SD_BENCH_MAX_P99_MS * 1000UL;
+
+	SdFile results;
+	if(results.open(&root, "BENCH.TXT", O_CREAT | O_WRITE | O_APPEND)) {
+		results.println(F("# SD card benchmark, latencies in ms, p50 is a bucket upper bound"));
+		results.print(F("#test\tcount\tp50\tp99\tmax\terrors"));
+		for(uint8_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+			results.print(F("\t<"));
+			print_ms(results, FIRST_BUCKET_US << bucket);
+		}
+		results.println();
+
+		report(results, F("sector_write"), sector_stats);
+		report(results, F("multi_block_write"), stream_stats);
+		report(results, F("append_flush"), append_stats);
+
+		results.println(passed ? F("# PASS") : F("# FAIL"));
+		results.println();
+		results.close();
+	}
+
+#ifdef DEBUG_TO_SERIAL
+	report(DEBUG_STREAM, F("sector_write"), sector_stats);
+	report(DEBUG_STREAM, F("multi_block_write"), stream_stats);
+	report(DEBUG_STREAM, F("append_flush"), append_stats);
+#endif
+
+	return passed ? SD_BENCH_PASSED : SD_BENCH_REJECTED;
+}
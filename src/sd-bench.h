@@ -0,0 +1,47 @@
+#pragma once
+
+#include <inttypes.h>
+
+/*
+Qualification of the SD card. The benchmark runs at boot when the firmware is built with -DSD_BENCHMARK or when the
+button on SD_BENCH_BUTTON_PIN is held down (pulled to ground) at power on. It times three write patterns:
+ - single 512 byte sector writes to a preallocated file;
+ - a multi-block write to the same preallocated file;
+ - short rows appended to a file and flushed one by one, as the logger does.
+The latency histograms, their p50/p99/max and the verdict are appended to BENCH.TXT.
+*/
+
+#ifndef SD_BENCH_BUTTON_PIN
+#define SD_BENCH_BUTTON_PIN 7
+#endif
+
+// A card is rejected when an appended and flushed row takes longer than this, in milliseconds
+#ifndef SD_BENCH_MAX_LATENCY_MS
+#define SD_BENCH_MAX_LATENCY_MS 100
+#endif
+
+// ... or when 1 in 100 of them takes longer than this, in milliseconds
+#ifndef SD_BENCH_MAX_P99_MS
+#define SD_BENCH_MAX_P99_MS 25
+#endif
+
+enum SdBenchResult {
+	SD_BENCH_PASSED,
+	SD_BENCH_REJECTED,   // the card is too slow or failed writes
+	SD_BENCH_CARD_ERROR  // the card could not be opened, or the test files created
+};
+
+/**
+ * Reads the button, so call it as soon as the board starts.
+ *
+ * @return Whether the benchmark was requested, by the build flag or the button.
+ */
+bool is_sd_bench_requested();
+
+/**
+ * Runs the benchmark and writes BENCH.TXT. It must run before `SD.begin()`.
+ *
+ * \param chip_select The chip select pin of the card.
+ * @return Whether the card is fit for logging, or why not.
+ */
+SdBenchResult run_sd_bench(uint8_t chip_select);
@@ -0,0 +1,56 @@
+#ifdef TELEMETRY_USB
+
+#include "telemetry.h"
+
+#include <Arduino.h>
+
+#include "frame.h"
+
+static uint16_t sequence = 0;
+static uint16_t unsent = 0;
+
+// The frame being sent, which can be larger than the free space of the USB endpoint
+static uint8_t frame[FRAME_ENCODED_SIZE(sizeof(TelemetryPacket))];
+static uint8_t frame_size = 0;
+static uint8_t frame_sent = 0;
+
+/**
+ * Writes as much of the pending frame as the USB endpoint can take without waiting.
+ */
+static void push_frame() {
+	int space = Serial.availableForWrite();
+	if(space <= 0) return;
+
+	uint8_t size = min((uint8_t) space, (uint8_t) (frame_size - frame_sent));
+	frame_sent += Serial.write(frame + frame_sent, size);
+}
+
+void send_telemetry(const Sample &sample) {
+	// Not `!Serial`, which waits 10ms on every call; DTR is set while a host has the port open
+	if(!Serial.dtr()) {
+		frame_size = frame_sent = 0;
+		sequence++;
+		unsent++;
+		return;
+	}
+
+	if(frame_sent < frame_size) push_frame();
+
+	// The host has not taken the previous frame yet, this one is dropped
+	if(frame_sent < frame_size) {
+		sequence++;
+		unsent++;
+		return;
+	}
+
+	TelemetryPacket packet;
+	packet.sequence = sequence++;
+	packet.unsent = unsent;
+	packet.sample = sample;
+
+	frame_size = encode_frame((const uint8_t *) &packet, sizeof(packet), frame);
+	frame_sent = 0;
+	push_frame();
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "sample.h"
+
+/*
+Binary live telemetry over the USB CDC port, enabled with -DTELEMETRY_USB. Every sample is sent as a frame (see
+frame.h) whose payload is a TelemetryPacket. The receiver in tools/ decodes them.
+*/
+
+struct __attribute__((packed)) TelemetryPacket {
+	uint16_t sequence;  // incremented for every sample, including those that could not be sent
+	uint16_t unsent;    // number of samples the logger could not send since boot
+	Sample sample;
+};
+
+#ifdef TELEMETRY_USB
+
+/**
+ * Sends a sample to the USB port. A frame is larger than the USB endpoint, so it is written as the endpoint frees up,
+ * over the next calls if need be. The sample is dropped, and never waited for, when no host is listening or the
+ * previous frame is still being sent; the receiver notices it from the sequence number and the unsent count.
+ *
+ * \param sample The sample to send.
+ */
+void send_telemetry(const Sample &sample);
+
+#else
+
+#define send_telemetry(sample) {}
+
+#endif
@@ -0,0 +1,481 @@
+// Bulk ingest of the LOG_XXXX.CSV files written by the logger.
+//
+// Usage: lidarbox-ingest [-j threads] -o <output directory> <LOG_XXXX.CSV>...
+//
+// Every file is a flight. The files are memory-mapped and parsed in parallel, then merged, in the order given, into
+// one contiguous little-endian array per column:
+//  - <column>.<type>: the values, where type is i32, f32 or f64;
+//  - columns.tsv: the name, type and number of values of each column;
+//  - flights.tsv: the source file, first row and number of rows of each flight.
+//
+// Missing values (`NaN`, `INVALID`, or a column absent from an older file) are NaN for floating point columns and
+// INT32_MIN for integer ones. Dates are stored as yyyymmdd and times as milliseconds since midnight.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr int32_t missing_int = std::numeric_limits<int32_t>::min();
+
+enum class ColumnType { DATE, TIME, INT32, FLOAT32, FLOAT64 };
+
+static const char *type_suffix(ColumnType type) {
+	switch(type) {
+		case ColumnType::FLOAT32: return "f32";
+		case ColumnType::FLOAT64: return "f64";
+		default: return "i32";
+	}
+}
+
+/**
+ * The type of a column is decided by its name, so it is the same across files.
+ */
+static ColumnType column_type(std::string_view name) {
+	if(name == "gmt_date") return ColumnType::DATE;
+	if(name == "gmt_time") return ColumnType::TIME;
+	if(name == "longitude" || name == "latitude") return ColumnType::FLOAT64;
+	if(name == "num_sats" || name == "HDOP" || name == "boot_ms" || name.find("_cm") != std::string_view::npos
+			|| name.find("_ms") != std::string_view::npos)
+		return ColumnType::INT32;
+	return ColumnType::FLOAT32;
+}
+
+/**
+ * The columns seen so far, shared by all the workers. A column keeps its index once registered.
+ */
+class Schema {
+public:
+	size_t index(std::string_view name) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for(size_t i = 0; i < names.size(); i++)
+			if(names[i] == name) return i;
+
+		names.emplace_back(name);
+		types.push_back(column_type(name));
+		return names.size() - 1;
+	}
+
+	size_t size() const { return names.size(); }
+
+	std::vector<std::string> names;
+	std::vector<ColumnType> types;
+
+private:
+	std::mutex mutex;
+};
+
+/**
+ * One column of one file. Integer and floating point values are kept apart so no precision is lost.
+ */
+struct ColumnData {
+	std::vector<int32_t> ints;
+	std::vector<float> floats;
+	std::vector<double> doubles;
+};
+
+struct ParsedFile {
+	std::vector<size_t> columns;  // schema index of each field of a row
+	std::vector<ColumnType> types;  // indexed like `columns`, so the workers never read the shared schema
+	std::vector<ColumnData> data;  // indexed like `columns`
+	size_t rows = 0;
+	size_t malformed = 0;
+	std::string error;
+};
+
+// 10^n, for the fraction digits
+static const double powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+};
+
+static bool is_missing(std::string_view field) {
+	return field.empty() || field == "NaN" || field.compare(0, 7, "INVALID") == 0;
+}
+
+/**
+ * Parses a decimal number. Only the notation written by the logger is supported: an optional sign, digits and an
+ * optional fraction.
+ *
+ * \return whether the whole field was a number
+ */
+static bool parse_decimal(std::string_view field, double &value) {
+	size_t i = 0;
+	bool negative = false;
+	if(i < field.size() && (field[i] == '-' || field[i] == '+')) negative = field[i++] == '-';
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int fraction_digits = 0;
+	bool fraction = false;
+
+	for(; i < field.size(); i++) {
+		char c = field[i];
+		if(c == '.' && !fraction) {
+			fraction = true;
+		} else if(c >= '0' && c <= '9') {
+			// Past 18 digits the value would overflow; they are beyond float precision anyway
+			if(digits < 18) {
+				mantissa = mantissa * 10 + (c - '0');
+				digits++;
+				if(fraction) fraction_digits++;
+			} else if(!fraction) {
+				return false;
+			}
+		} else {
+			return false;
+		}
+	}
+	if(digits == 0) return false;
+
+	value = (double) mantissa / powers_of_ten[fraction_digits];
+	if(negative) value = -value;
+	return true;
+}
+
+static bool parse_int(std::string_view field, int32_t &value) {
+	double parsed;
+	if(!parse_decimal(field, parsed) || parsed < missing_int || parsed > std::numeric_limits<int32_t>::max())
+		return false;
+
+	value = (int32_t) std::lround(parsed);
+	return true;
+}
+
+/**
+ * Parses fixed-width digits.
+ */
+static bool parse_digits(std::string_view field, size_t start, size_t count, int32_t &value) {
+	if(start + count > field.size()) return false;
+
+	value = 0;
+	for(size_t i = start; i < start + count; i++) {
+		if(field[i] < '0' || field[i] > '9') return false;
+		value = value * 10 + (field[i] - '0');
+	}
+	return true;
+}
+
+// yyyy/mm/dd
+static bool parse_date(std::string_view field, int32_t &value) {
+	int32_t year, month, day;
+	if(field.size() != 10 || field[4] != '/' || field[7] != '/') return false;
+	if(!parse_digits(field, 0, 4, year) || !parse_digits(field, 5, 2, month) || !parse_digits(field, 8, 2, day))
+		return false;
+
+	value = year * 10000 + month * 100 + day;
+	return true;
+}
+
+// hh:mm:ss, optionally followed by .cc
+static bool parse_time(std::string_view field, int32_t &value) {
+	int32_t hour, minute, second, centisecond = 0;
+	if(field.size() < 8 || field[2] != ':' || field[5] != ':') return false;
+	if(!parse_digits(field, 0, 2, hour) || !parse_digits(field, 3, 2, minute) || !parse_digits(field, 6, 2, second))
+		return false;
+
+	if(field.size() > 8) {
+		if(field.size() != 11 || field[8] != '.' || !parse_digits(field, 9, 2, centisecond)) return false;
+	}
+
+	value = ((hour * 60 + minute) * 60 + second) * 1000 + centisecond * 10;
+	return true;
+}
+
+static std::string_view trim(std::string_view field) {
+	while(!field.empty() && (field.back() == ' ' || field.back() == '\r')) field.remove_suffix(1);
+	while(!field.empty() && field.front() == ' ') field.remove_prefix(1);
+	return field;
+}
+
+/**
+ * Appends a field to its column.
+ *
+ * \return whether the field could be parsed
+ */
+static bool append_field(ColumnType type, std::string_view field, ColumnData &column) {
+	field = trim(field);
+	bool missing = is_missing(field);
+
+	switch(type) {
+		case ColumnType::DATE:
+		case ColumnType::TIME:
+		case ColumnType::INT32: {
+			int32_t value = missing_int;
+			bool ok = missing || (type == ColumnType::DATE ? parse_date(field, value)
+				: type == ColumnType::TIME ? parse_time(field, value) : parse_int(field, value));
+			column.ints.push_back(ok ? value : missing_int);
+			return ok;
+		}
+		case ColumnType::FLOAT32:
+		case ColumnType::FLOAT64: {
+			double value = NAN;
+			bool ok = missing || parse_decimal(field, value);
+			if(!ok) value = NAN;
+			if(type == ColumnType::FLOAT32) column.floats.push_back((float) value);
+			else column.doubles.push_back(value);
+			return ok;
+		}
+	}
+	return false;
+}
+
+/**
+ * Drops the values a malformed row added to the columns.
+ */
+static void truncate(ParsedFile &result) {
+	for(size_t i = 0; i < result.columns.size(); i++) {
+		ColumnData &column = result.data[i];
+		switch(result.types[i]) {
+			case ColumnType::FLOAT32: column.floats.resize(result.rows); break;
+			case ColumnType::FLOAT64: column.doubles.resize(result.rows); break;
+			default: column.ints.resize(result.rows); break;
+		}
+	}
+}
+
+static void parse_buffer(const char *begin, const char *end, Schema &schema, ParsedFile &result) {
+	const char *line = begin;
+
+	while(line < end) {
+		const char *eol = static_cast<const char *>(memchr(line, '\n', end - line));
+		if(!eol) eol = end;
+		std::string_view row(line, eol - line);
+		line = eol + 1;
+
+		if(!row.empty() && row.back() == '\r') row.remove_suffix(1);
+		if(row.empty()) continue;
+
+		if(row[0] == '#') {
+			// Of the comments, only the header names the columns, and it names every one of them
+			if(row.find('\t') == std::string_view::npos || !result.columns.empty()) continue;
+
+			row.remove_prefix(1);
+			while(!row.empty()) {
+				size_t tab = row.find('\t');
+				std::string_view name = trim(row.substr(0, tab));
+				result.columns.push_back(schema.index(name));
+				result.types.push_back(column_type(name));
+				if(tab == std::string_view::npos) break;
+				row.remove_prefix(tab + 1);
+			}
+			result.data.resize(result.columns.size());
+			continue;
+		}
+
+		if(result.columns.empty()) {
+			result.error = "data before the column header";
+			return;
+		}
+
+		size_t field_index = 0;
+		bool ok = true;
+		while(ok) {
+			size_t tab = row.find('\t');
+			if(field_index >= result.columns.size()) {
+				ok = false;
+				break;
+			}
+
+			ok = append_field(result.types[field_index], row.substr(0, tab), result.data[field_index]);
+			field_index++;
+
+			if(tab == std::string_view::npos) break;
+			row.remove_prefix(tab + 1);
+		}
+
+		// A row cut short is most likely the last one, written as the power went off
+		if(ok && field_index == result.columns.size()) {
+			result.rows++;
+		} else {
+			result.malformed++;
+			truncate(result);
+		}
+	}
+}
+
+static void parse_file(const char *path, Schema &schema, ParsedFile &result) {
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		result.error = strerror(errno);
+		return;
+	}
+
+	struct stat info;
+	if(fstat(fd, &info) < 0) {
+		result.error = strerror(errno);
+		close(fd);
+		return;
+	}
+
+	if(info.st_size == 0) {
+		close(fd);
+		return;
+	}
+
+	void *map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		result.error = strerror(errno);
+		return;
+	}
+	madvise(map, info.st_size, MADV_SEQUENTIAL);
+
+	const char *begin = static_cast<const char *>(map);
+	parse_buffer(begin, begin + info.st_size, schema, result);
+
+	munmap(map, info.st_size);
+}
+
+/**
+ * Writes the values of a column, from every file in order, to its own file.
+ */
+static bool write_column(const std::string &directory, size_t index, const Schema &schema,
+		const std::vector<ParsedFile> &files, size_t &count) {
+	ColumnType type = schema.types[index];
+	std::string path = directory + "/" + schema.names[index] + "." + type_suffix(type);
+
+	FILE *out = fopen(path.c_str(), "wb");
+	if(!out) {
+		fprintf(stderr, "Cannot create %s: %s\n", path.c_str(), strerror(errno));
+		return false;
+	}
+
+	count = 0;
+	for(const ParsedFile &file : files) {
+		auto position = std::find(file.columns.begin(), file.columns.end(), index);
+
+		if(position != file.columns.end()) {
+			const ColumnData &column = file.data[position - file.columns.begin()];
+			switch(type) {
+				case ColumnType::FLOAT32: fwrite(column.floats.data(), sizeof(float), file.rows, out); break;
+				case ColumnType::FLOAT64: fwrite(column.doubles.data(), sizeof(double), file.rows, out); break;
+				default: fwrite(column.ints.data(), sizeof(int32_t), file.rows, out); break;
+			}
+		} else {
+			// The column did not exist when this file was written
+			if(type == ColumnType::FLOAT32) {
+				std::vector<float> values(file.rows, NAN);
+				fwrite(values.data(), sizeof(float), file.rows, out);
+			} else if(type == ColumnType::FLOAT64) {
+				std::vector<double> values(file.rows, NAN);
+				fwrite(values.data(), sizeof(double), file.rows, out);
+			} else {
+				std::vector<int32_t> values(file.rows, missing_int);
+				fwrite(values.data(), sizeof(int32_t), file.rows, out);
+			}
+		}
+		count += file.rows;
+	}
+
+	bool ok = !ferror(out);
+	ok = fclose(out) == 0 && ok;
+	if(!ok) fprintf(stderr, "Cannot write %s\n", path.c_str());
+	return ok;
+}
+
+static int usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-j threads] -o <output directory> <LOG_XXXX.CSV>...\n", name);
+	return 2;
+}
+
+int main(int argc, char **argv) {
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	std::string directory;
+	std::vector<const char *> paths;
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = std::max(1, atoi(argv[++i]));
+		else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) directory = argv[++i];
+		else if(argv[i][0] == '-') return usage(argv[0]);
+		else paths.push_back(argv[i]);
+	}
+	if(directory.empty() || paths.empty()) return usage(argv[0]);
+
+	if(mkdir(directory.c_str(), 0777) < 0 && errno != EEXIST) {
+		fprintf(stderr, "Cannot create %s: %s\n", directory.c_str(), strerror(errno));
+		return 1;
+	}
+
+	Schema schema;
+	std::vector<ParsedFile> files(paths.size());
+
+	// The workers take the next file until there is none left
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> pool;
+	for(unsigned t = 0; t < std::min<size_t>(threads, paths.size()); t++) {
+		pool.emplace_back([&]() {
+			for(size_t i = next++; i < paths.size(); i = next++)
+				parse_file(paths[i], schema, files[i]);
+		});
+	}
+	for(std::thread &worker : pool) worker.join();
+
+	int status = 0;
+	size_t total_rows = 0;
+	for(size_t i = 0; i < files.size(); i++) {
+		if(!files[i].error.empty()) {
+			fprintf(stderr, "%s: %s\n", paths[i], files[i].error.c_str());
+			status = 1;
+		}
+		if(files[i].malformed > 0)
+			fprintf(stderr, "%s: skipped %zu malformed rows\n", paths[i], files[i].malformed);
+		total_rows += files[i].rows;
+	}
+
+	// Each column is a file of its own, so they are written in parallel too
+	std::vector<size_t> counts(schema.size());
+	std::atomic<bool> write_ok(true);
+	next = 0;
+	pool.clear();
+	for(unsigned t = 0; t < std::min<size_t>(threads, schema.size()); t++) {
+		pool.emplace_back([&]() {
+			for(size_t i = next++; i < schema.size(); i = next++)
+				if(!write_column(directory, i, schema, files, counts[i])) write_ok = false;
+		});
+	}
+	for(std::thread &worker : pool) worker.join();
+	if(!write_ok) return 1;
+
+	FILE *index = fopen((directory + "/columns.tsv").c_str(), "w");
+	if(!index) {
+		fprintf(stderr, "Cannot create columns.tsv: %s\n", strerror(errno));
+		return 1;
+	}
+	fprintf(index, "#name\ttype\tcount\n");
+	for(size_t i = 0; i < schema.size(); i++)
+		fprintf(index, "%s\t%s\t%zu\n", schema.names[i].c_str(), type_suffix(schema.types[i]), counts[i]);
+	fclose(index);
+
+	FILE *flights = fopen((directory + "/flights.tsv").c_str(), "w");
+	if(!flights) {
+		fprintf(stderr, "Cannot create flights.tsv: %s\n", strerror(errno));
+		return 1;
+	}
+	fprintf(flights, "#flight\tfile\tfirst_row\trows\n");
+	size_t first_row = 0;
+	for(size_t i = 0; i < files.size(); i++) {
+		fprintf(flights, "%zu\t%s\t%zu\t%zu\n", i, paths[i], first_row, files[i].rows);
+		first_row += files[i].rows;
+	}
+	fclose(flights);
+
+	fprintf(stderr, "%zu files, %zu rows, %zu columns\n", files.size(), total_rows, schema.size());
+
+	return status;
+}
@@ -0,0 +1,260 @@
+// Receiver for the binary live telemetry sent by the logger when built with -DTELEMETRY_USB.
+//
+// Usage: lidarbox-telemetry <device> [output]
+//
+// Decodes the frames read from the USB CDC port (e.g. /dev/ttyACM0) and prints one tab-separated row per sample to
+// the output file, or to stdout. Statistics, including the number of dropped frames, are reported to stderr.
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "../src/frame.h"
+#include "../src/sample.h"
+#include "../src/telemetry.h"
+
+// How often the statistics are reported, in seconds
+constexpr time_t report_period_s = 5;
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int) {
+	running = 0;
+}
+
+struct Statistics {
+	unsigned long frames = 0;
+	unsigned long dropped = 0;
+	unsigned long unsent = 0;  // of the dropped frames, those the logger did not send
+	unsigned long corrupt = 0;
+	unsigned long resets = 0;
+
+	bool synchronised = false;
+	uint16_t next_sequence = 0;
+	uint16_t last_unsent = 0;
+};
+
+/**
+ * Opens the serial port in raw mode.
+ *
+ * \param path The path of the device.
+ * \return the file descriptor
+ * \retval -1 on error, with errno set
+ */
+static int open_port(const char *path) {
+	int fd = open(path, O_RDONLY | O_NOCTTY);
+	if(fd < 0) return -1;
+
+	termios tty;
+	if(tcgetattr(fd, &tty) == 0) {
+		// The baud rate means nothing for USB CDC, but the port must not cook the bytes
+		cfmakeraw(&tty);
+		cfsetispeed(&tty, B115200);
+		tty.c_cflag |= CLOCAL | CREAD | HUPCL;
+		tty.c_cc[VMIN] = 1;
+		tty.c_cc[VTIME] = 0;
+		tcsetattr(fd, TCSANOW, &tty);
+	}
+	tcflush(fd, TCIFLUSH);
+
+	return fd;
+}
+
+/**
+ * Prints a fixed-point number.
+ *
+ * \param out      The output.
+ * \param value    The number, scaled by 10^decimals.
+ * \param decimals The number of digits after the decimal point.
+ */
+static void print_fixed(FILE *out, long value, int decimals) {
+	long scale = 1;
+	for(int i = 0; i < decimals; i++) scale *= 10;
+
+	fprintf(out, "%s%ld.%0*ld", value < 0 ? "-" : "", labs(value) / scale, decimals, labs(value) % scale);
+}
+
+static void print_header(FILE *out) {
+	fprintf(out, "#sequence\tboot_ms\tgmt_date\tgmt_time\tnum_sats\tlongitude\tlatitude\t");
+	fprintf(out, "gps_altitude_m\tSOG_kt\tCOG\tHDOP\tlaser_altitude_cm\t");
+	for(int i = 1; i < MAX_LIDARS; i++) fprintf(out, "laser%d_altitude_cm\t", i + 1);
+	fprintf(out, "tilt_deg\taccel_x\taccel_y\taccel_z\tgyro_x\tgyro_y\tgyro_z\textrap_age_ms\tsampling\n");
+}
+
+static void print_packet(FILE *out, const TelemetryPacket &packet) {
+	const Sample &s = packet.sample;
+
+	fprintf(out, "%u\t%lu\t", (unsigned) packet.sequence, (unsigned long) s.boot_ms);
+
+	if(s.flags & SAMPLE_DATE_VALID) fprintf(out, "%u/%02u/%02u\t", (unsigned) s.year, s.month, s.day);
+	else fputs("INVALID\t", out);
+
+	if(s.flags & SAMPLE_TIME_VALID) fprintf(out, "%02u:%02u:%02u.%02u\t", s.hour, s.minute, s.second, s.centisecond);
+	else fputs("INVALID\t", out);
+
+	fprintf(out, "%u\t", s.num_sats);
+
+	if(s.flags & SAMPLE_LOCATION_VALID) {
+		print_fixed(out, s.longitude_e7, 7);
+		fputc('\t', out);
+		print_fixed(out, s.latitude_e7, 7);
+		fputc('\t', out);
+	} else {
+		fputs("NaN\tNaN\t", out);
+	}
+
+	if(s.flags & SAMPLE_ALTITUDE_VALID) print_fixed(out, s.gps_altitude_cm, 2);
+	else fputs("NaN", out);
+	fputc('\t', out);
+	if(s.flags & SAMPLE_SPEED_VALID) print_fixed(out, s.speed_ckn, 2);
+	else fputs("NaN", out);
+	fputc('\t', out);
+	if(s.flags & SAMPLE_COURSE_VALID) print_fixed(out, s.course_cdeg, 2);
+	else fputs("NaN", out);
+	fputc('\t', out);
+	if(s.flags & SAMPLE_HDOP_VALID) fprintf(out, "%u", (unsigned) s.hdop);
+	else fputs("NaN", out);
+	fputc('\t', out);
+
+	for(int i = 0; i < MAX_LIDARS; i++) {
+		if(s.lidar_cm[i] == -1) fputs("NaN\t", out);
+		else fprintf(out, "%d\t", s.lidar_cm[i]);
+	}
+
+	fprintf(out, "%.2f\t%.4f\t%.4f\t%.4f\t%.3f\t%.3f\t%.3f\t",
+		s.tilt_deg, s.accel_x, s.accel_y, s.accel_z, s.gyro_x, s.gyro_y, s.gyro_z);
+
+	if(s.flags & SAMPLE_LOCATION_VALID) fprintf(out, "%u\t", (unsigned) s.extrap_age_ms);
+	else fputs("NaN\t", out);
+
+	switch(s.sampling_level) {
+		case SAMPLING_FLOOR: fputs("floor\n", out); break;
+		case SAMPLING_NORMAL: fputs("normal\n", out); break;
+		case SAMPLING_BURST: fputs("burst\n", out); break;
+		default: fprintf(out, "%u\n", s.sampling_level);
+	}
+}
+
+static void report(const Statistics &stats) {
+	fprintf(stderr, "frames: %lu  dropped: %lu (unsent: %lu)  corrupt: %lu  resets: %lu\n",
+		stats.frames, stats.dropped, stats.unsent, stats.corrupt, stats.resets);
+}
+
+/**
+ * Decodes a frame, updates the statistics and prints the sample.
+ *
+ * \param frame The frame, without its terminating zero. It is decoded in place.
+ */
+static void handle_frame(std::vector<uint8_t> &frame, Statistics &stats, FILE *out) {
+	if(frame.empty()) return;
+
+	int size = decode_frame(frame.data(), frame.size(), frame.data());
+	if(size != sizeof(TelemetryPacket)) {
+		stats.corrupt++;
+		return;
+	}
+
+	TelemetryPacket packet;
+	memcpy(&packet, frame.data(), sizeof(packet));
+
+	if(stats.synchronised) {
+		uint16_t gap = packet.sequence - stats.next_sequence;
+
+		// A sequence going backwards means the logger rebooted
+		if(gap < 0x8000) {
+			stats.dropped += gap;
+			stats.unsent += (uint16_t) (packet.unsent - stats.last_unsent);
+		} else {
+			stats.resets++;
+		}
+	}
+	stats.last_unsent = packet.unsent;
+	stats.synchronised = true;
+	stats.next_sequence = packet.sequence + 1;
+	stats.frames++;
+
+	print_packet(out, packet);
+}
+
+int main(int argc, char **argv) {
+	if(argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s <device> [output]\n", argv[0]);
+		return 2;
+	}
+
+	int fd = open_port(argv[1]);
+	if(fd < 0) {
+		fprintf(stderr, "Cannot open %s: %s\n", argv[1], strerror(errno));
+		return 1;
+	}
+
+	FILE *out = stdout;
+	if(argc == 3) {
+		out = fopen(argv[2], "w");
+		if(!out) {
+			fprintf(stderr, "Cannot open %s: %s\n", argv[2], strerror(errno));
+			return 1;
+		}
+	}
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	print_header(out);
+
+	Statistics stats;
+	std::vector<uint8_t> frame;
+	frame.reserve(FRAME_ENCODED_SIZE(sizeof(TelemetryPacket)));
+
+	// The first frame is most likely truncated, skip until the first delimiter
+	bool in_sync = false;
+	time_t last_report = time(nullptr);
+
+	while(running) {
+		pollfd pfd = { fd, POLLIN, 0 };
+		int ready = poll(&pfd, 1, 1000);
+		if(ready < 0 && errno != EINTR) break;
+
+		if(ready > 0) {
+			uint8_t buffer[512];
+			ssize_t size = read(fd, buffer, sizeof(buffer));
+			if(size < 0 && errno != EINTR && errno != EAGAIN) break;
+			if(size == 0) break;  // the device was unplugged
+
+			for(ssize_t i = 0; i < size; i++) {
+				if(buffer[i] != 0) {
+					// Anything larger than a frame is garbage, keep it from growing forever
+					if(frame.size() < FRAME_ENCODED_SIZE(sizeof(TelemetryPacket))) frame.push_back(buffer[i]);
+					continue;
+				}
+
+				if(in_sync) handle_frame(frame, stats, out);
+				in_sync = true;
+				frame.clear();
+			}
+			fflush(out);
+		}
+
+		time_t now = time(nullptr);
+		if(now - last_report >= report_period_s) {
+			report(stats);
+			last_report = now;
+		}
+	}
+
+	report(stats);
+
+	if(out != stdout) fclose(out);
+	close(fd);
+
+	return 0;
+}